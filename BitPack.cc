@@ -0,0 +1,177 @@
+#include "BitPack.h"
+
+#if defined(__x86_64__)
+#define SERIAL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace serial {
+
+    namespace {
+
+        using Unpack = void (*)(const std::byte* in, std::size_t count, unsigned width, uint64_t* out);
+        using AddGaps = uint64_t (*)(uint64_t* values, std::size_t count, uint64_t prev);
+
+        /**
+         * @brief The functions of one instruction set
+         */
+        struct Kernels {
+            Unpack unpack;
+            AddGaps addGaps;
+            const char* name;
+        };
+
+        uint64_t lowBits(unsigned width) {
+            return width >= 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+        }
+
+        uint64_t loadLittleEndian64(const std::byte* in) {
+            uint64_t x = 0;
+            for (int i = 7; i >= 0; i--) {
+                x = (x << 8) | std::to_integer<uint64_t>(in[i]);
+            }
+            return x;
+        }
+
+#ifdef SERIAL_X86
+
+        // Each lane loads the 8 bytes that hold its value with a gather, then
+        // shifts it down: a value must fit in the 64 bits after its first
+        // bit, so the widest ones are left to the scalar version
+        constexpr unsigned MaxGatherWidth = 56;
+
+        __attribute__((target("avx2")))
+        void avx2Unpack(const std::byte* in, std::size_t count, unsigned width, uint64_t* out) {
+            if (width > MaxGatherWidth) {
+                detail::unpackBitsScalar(in, count, width, out);
+                return;
+            }
+
+            const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(lowBits(width)));
+            const __m256i seven = _mm256_set1_epi64x(7);
+            const __m256i step = _mm256_set1_epi64x(static_cast<long long>(4 * width));
+            __m256i bits = _mm256_set_epi64x(3 * width, 2 * width, width, 0);
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                const __m256i bytes = _mm256_srli_epi64(bits, 3);
+                __m256i x = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(in), bytes, 1);
+                x = _mm256_srlv_epi64(x, _mm256_and_si256(bits, seven));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_and_si256(x, mask));
+                bits = _mm256_add_epi64(bits, step);
+            }
+
+            for (; i < count; i++) {
+                const std::size_t bit = i * width;
+                out[i] = loadLittleEndian64(in + bit / 8) >> (bit & 7) & lowBits(width);
+            }
+        }
+
+        __attribute__((target("avx2")))
+        uint64_t avx2AddGaps(uint64_t* values, std::size_t count, uint64_t prev) {
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i one = _mm256_set1_epi64x(1);
+            __m256i carry = _mm256_set1_epi64x(static_cast<long long>(prev));
+
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                __m256i x = _mm256_add_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), one);
+                // prefix sum of the 4 lanes in 2 steps: [a, a+b, b+c, c+d], then [a, a+b, a+b+c, a+b+c+d]
+                x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x03));
+                x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x0F));
+                x = _mm256_add_epi64(x, carry);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), x);
+                carry = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+            }
+
+            if (i > 0) {
+                prev = values[i - 1];
+            }
+            return detail::addGapsScalar(values + i, count - i, prev);
+        }
+
+#endif // SERIAL_X86
+
+        Kernels selectKernels() {
+#ifdef SERIAL_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) {
+                return { avx2Unpack, avx2AddGaps, "avx2" };
+            }
+#endif
+            return { detail::unpackBitsScalar, detail::addGapsScalar, "scalar" };
+        }
+
+        const Kernels& kernels() {
+            static const Kernels selected = selectKernels();
+            return selected;
+        }
+
+    }
+
+    std::size_t packBits(const uint64_t* values, std::size_t count, unsigned width, std::byte* out) {
+        const uint64_t mask = lowBits(width);
+        std::size_t size = 0;
+        uint64_t acc = 0;
+        unsigned used = 0;
+
+        for (std::size_t i = 0; i < count; i++) {
+            const uint64_t x = values[i] & mask;
+            acc |= x << used;
+            if (used + width < 64) {
+                used += width;
+                continue;
+            }
+
+            for (int k = 0; k < 8; k++) {
+                out[size++] = static_cast<std::byte>(acc >> (8 * k));
+            }
+            // the bits that did not fit
+            acc = used == 0 ? 0 : x >> (64 - used);
+            used = used + width - 64;
+        }
+
+        for (unsigned k = 0; 8 * k < used; k++) {
+            out[size++] = static_cast<std::byte>(acc >> (8 * k));
+        }
+        return size;
+    }
+
+    void unpackBits(const std::byte* in, std::size_t count, unsigned width, uint64_t* out) {
+        kernels().unpack(in, count, width, out);
+    }
+
+    uint64_t addGaps(uint64_t* values, std::size_t count, uint64_t prev) {
+        return kernels().addGaps(values, count, prev);
+    }
+
+    const char* bitPackKernel() {
+        return kernels().name;
+    }
+
+    namespace detail {
+
+        void unpackBitsScalar(const std::byte* in, std::size_t count, unsigned width, uint64_t* out) {
+            const uint64_t mask = lowBits(width);
+            for (std::size_t i = 0; i < count; i++) {
+                const std::size_t bit = i * width;
+                const unsigned shift = bit & 7;
+                uint64_t x = loadLittleEndian64(in + bit / 8) >> shift;
+                if (shift + width > 64) {
+                    x |= std::to_integer<uint64_t>(in[bit / 8 + 8]) << (64 - shift);
+                }
+                out[i] = x & mask;
+            }
+        }
+
+        uint64_t addGapsScalar(uint64_t* values, std::size_t count, uint64_t prev) {
+            for (std::size_t i = 0; i < count; i++) {
+                prev += values[i] + 1;
+                values[i] = prev;
+            }
+            return prev;
+        }
+
+    } // namespace detail
+
+}
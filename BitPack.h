@@ -0,0 +1,61 @@
+#ifndef BIT_PACK_H
+#define BIT_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace serial {
+
+  /**
+   * @brief Number of bits needed to store `x`, 0 for 0
+   */
+  inline unsigned bitWidth(uint64_t x) {
+    return x == 0 ? 0 : 64 - static_cast<unsigned>(__builtin_clzll(x));
+  }
+
+  /**
+   * @brief Store the low `width` bits of `count` values one after the other
+   * at `out`, from the low bits of the first byte
+   *
+   * `width` is at most 64. Returns the number of bytes written, which is
+   * `(count * width + 7) / 8`.
+   */
+  std::size_t packBits(const uint64_t* values, std::size_t count, unsigned width, std::byte* out);
+
+  /**
+   * @brief Load `count` values packed by `packBits()` with this `width`
+   *
+   * `in` must be followed by 8 readable bytes after the packed ones. The
+   * fastest kernel supported by the CPU is chosen at the first call.
+   */
+  void unpackBits(const std::byte* in, std::size_t count, unsigned width, uint64_t* out);
+
+  /**
+   * @brief Turn the gaps between strictly increasing keys, minus one, back
+   * into the keys that follow `prev`
+   *
+   * `values[i]` becomes `prev + (values[0] + 1) + ... + (values[i] + 1)`,
+   * modulo 2^64. Returns the last key, or `prev` if `count` is 0.
+   */
+  uint64_t addGaps(uint64_t* values, std::size_t count, uint64_t prev);
+
+  /**
+   * @brief The name of the kernel used by `unpackBits()` and `addGaps()`:
+   * "avx2" or "scalar"
+   */
+  const char* bitPackKernel();
+
+  namespace detail {
+
+    /**
+     * @brief The portable versions of `unpackBits()` and `addGaps()`,
+     * whatever the CPU
+     */
+    void unpackBitsScalar(const std::byte* in, std::size_t count, unsigned width, uint64_t* out);
+    uint64_t addGapsScalar(uint64_t* values, std::size_t count, uint64_t prev);
+
+  } // namespace detail
+
+} // namespace serial
+
+#endif // BIT_PACK_H
@@ -0,0 +1,217 @@
+#include "ByteSwap.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SERIAL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace serial {
+
+    namespace {
+
+        using Kernel = void (*)(std::byte* dst, const std::byte* src, std::size_t count);
+
+        /**
+         * @brief The byte swap functions of one instruction set
+         */
+        struct Kernels {
+            Kernel swap16;
+            Kernel swap32;
+            Kernel swap64;
+            const char* name;
+        };
+
+        // Scalar versions, also used for the tail of the vectorized ones
+
+        void scalarSwap16(std::byte* dst, const std::byte* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; i++) {
+                uint16_t x;
+                std::memcpy(&x, src + 2 * i, 2);
+                x = __builtin_bswap16(x);
+                std::memcpy(dst + 2 * i, &x, 2);
+            }
+        }
+
+        void scalarSwap32(std::byte* dst, const std::byte* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; i++) {
+                uint32_t x;
+                std::memcpy(&x, src + 4 * i, 4);
+                x = __builtin_bswap32(x);
+                std::memcpy(dst + 4 * i, &x, 4);
+            }
+        }
+
+        void scalarSwap64(std::byte* dst, const std::byte* src, std::size_t count) {
+            for (std::size_t i = 0; i < count; i++) {
+                uint64_t x;
+                std::memcpy(&x, src + 8 * i, 8);
+                x = __builtin_bswap64(x);
+                std::memcpy(dst + 8 * i, &x, 8);
+            }
+        }
+
+#ifdef SERIAL_X86
+
+        // SSE2 has no byte shuffle: swap the bytes of each 16 bits word with
+        // shifts, then reorder the words
+
+        __attribute__((target("sse2")))
+        __m128i sse2Swap16(__m128i v) {
+            return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        }
+
+        __attribute__((target("sse2")))
+        void sse2Swap16(std::byte* dst, const std::byte* src, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), sse2Swap16(v));
+            }
+            scalarSwap16(dst + 2 * i, src + 2 * i, count - i);
+        }
+
+        __attribute__((target("sse2")))
+        void sse2Swap32(std::byte* dst, const std::byte* src, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+                v = sse2Swap16(v);
+                v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+                v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), v);
+            }
+            scalarSwap32(dst + 4 * i, src + 4 * i, count - i);
+        }
+
+        __attribute__((target("sse2")))
+        void sse2Swap64(std::byte* dst, const std::byte* src, std::size_t count) {
+            std::size_t i = 0;
+            for (; i + 2 <= count; i += 2) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 8 * i));
+                v = sse2Swap16(v);
+                v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+                v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8 * i), v);
+            }
+            scalarSwap64(dst + 8 * i, src + 8 * i, count - i);
+        }
+
+        // AVX2 reverses the bytes with one shuffle per 32 bytes
+
+        __attribute__((target("avx2")))
+        void avx2Swap(std::byte* dst, const std::byte* src, std::size_t bytes, __m256i mask) {
+            std::size_t i = 0;
+            for (; i + 64 <= bytes; i += 64) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(a, mask));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), _mm256_shuffle_epi8(b, mask));
+            }
+            for (; i + 32 <= bytes; i += 32) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(a, mask));
+            }
+        }
+
+        __attribute__((target("avx2")))
+        void avx2Swap16(std::byte* dst, const std::byte* src, std::size_t count) {
+            const __m256i mask = _mm256_setr_epi8(
+                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+            const std::size_t done = count / 16 * 16;
+            avx2Swap(dst, src, 2 * done, mask);
+            scalarSwap16(dst + 2 * done, src + 2 * done, count - done);
+        }
+
+        __attribute__((target("avx2")))
+        void avx2Swap32(std::byte* dst, const std::byte* src, std::size_t count) {
+            const __m256i mask = _mm256_setr_epi8(
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+            const std::size_t done = count / 8 * 8;
+            avx2Swap(dst, src, 4 * done, mask);
+            scalarSwap32(dst + 4 * done, src + 4 * done, count - done);
+        }
+
+        __attribute__((target("avx2")))
+        void avx2Swap64(std::byte* dst, const std::byte* src, std::size_t count) {
+            const __m256i mask = _mm256_setr_epi8(
+                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+            const std::size_t done = count / 4 * 4;
+            avx2Swap(dst, src, 8 * done, mask);
+            scalarSwap64(dst + 8 * done, src + 8 * done, count - done);
+        }
+
+#endif // SERIAL_X86
+
+        Kernels selectKernels() {
+#ifdef SERIAL_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) {
+                return { avx2Swap16, avx2Swap32, avx2Swap64, "avx2" };
+            }
+            if (__builtin_cpu_supports("sse2")) {
+                return { sse2Swap16, sse2Swap32, sse2Swap64, "sse2" };
+            }
+#endif
+            return { scalarSwap16, scalarSwap32, scalarSwap64, "scalar" };
+        }
+
+        const Kernels& kernels() {
+            static const Kernels selected = selectKernels();
+            return selected;
+        }
+
+    }
+
+    void byteSwap16(std::byte* dst, const std::byte* src, std::size_t count) {
+        kernels().swap16(dst, src, count);
+    }
+
+    void byteSwap32(std::byte* dst, const std::byte* src, std::size_t count) {
+        kernels().swap32(dst, src, count);
+    }
+
+    void byteSwap64(std::byte* dst, const std::byte* src, std::size_t count) {
+        kernels().swap64(dst, src, count);
+    }
+
+    const char* byteSwapKernel() {
+        return kernels().name;
+    }
+
+    namespace detail {
+
+        void byteSwap16Scalar(std::byte* dst, const std::byte* src, std::size_t count) {
+            scalarSwap16(dst, src, count);
+        }
+
+        void byteSwap32Scalar(std::byte* dst, const std::byte* src, std::size_t count) {
+            scalarSwap32(dst, src, count);
+        }
+
+        void byteSwap64Scalar(std::byte* dst, const std::byte* src, std::size_t count) {
+            scalarSwap64(dst, src, count);
+        }
+
+#ifdef SERIAL_X86
+        void byteSwap16Sse2(std::byte* dst, const std::byte* src, std::size_t count) {
+            sse2Swap16(dst, src, count);
+        }
+
+        void byteSwap32Sse2(std::byte* dst, const std::byte* src, std::size_t count) {
+            sse2Swap32(dst, src, count);
+        }
+
+        void byteSwap64Sse2(std::byte* dst, const std::byte* src, std::size_t count) {
+            sse2Swap64(dst, src, count);
+        }
+#endif
+
+    } // namespace detail
+
+}
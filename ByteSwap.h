@@ -0,0 +1,57 @@
+#ifndef BYTE_SWAP_H
+#define BYTE_SWAP_H
+
+#include <cstddef>
+
+namespace serial {
+
+  /**
+   * @brief Copy `count` 16 bits values from `src` to `dst`, reversing the
+   * order of the bytes of each value
+   *
+   * `src` and `dst` may be the same buffer but must not overlap otherwise.
+   * The fastest kernel supported by the CPU is chosen at the first call.
+   */
+  void byteSwap16(std::byte* dst, const std::byte* src, std::size_t count);
+
+  /**
+   * @brief Same as `byteSwap16()` for 32 bits values (integers or `float`)
+   */
+  void byteSwap32(std::byte* dst, const std::byte* src, std::size_t count);
+
+  /**
+   * @brief Same as `byteSwap16()` for 64 bits values (integers or `double`)
+   */
+  void byteSwap64(std::byte* dst, const std::byte* src, std::size_t count);
+
+  /**
+   * @brief The name of the kernel used by the byte swap functions: "avx2",
+   * "sse2" or "scalar"
+   */
+  const char* byteSwapKernel();
+
+  namespace detail {
+
+    /**
+     * @brief The portable versions of the byte swap functions, whatever the
+     * CPU
+     */
+    void byteSwap16Scalar(std::byte* dst, const std::byte* src, std::size_t count);
+    void byteSwap32Scalar(std::byte* dst, const std::byte* src, std::size_t count);
+    void byteSwap64Scalar(std::byte* dst, const std::byte* src, std::size_t count);
+
+#if defined(__x86_64__) || defined(__i386__)
+    /**
+     * @brief The SSE2 versions of the byte swap functions, the CPU must
+     * support SSE2
+     */
+    void byteSwap16Sse2(std::byte* dst, const std::byte* src, std::size_t count);
+    void byteSwap32Sse2(std::byte* dst, const std::byte* src, std::size_t count);
+    void byteSwap64Sse2(std::byte* dst, const std::byte* src, std::size_t count);
+#endif
+
+  } // namespace detail
+
+} // namespace serial
+
+#endif // BYTE_SWAP_H
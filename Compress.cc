@@ -0,0 +1,376 @@
+#include "Compress.h"
+
+#include "Crc32c.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef SERIAL_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef SERIAL_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace serial {
+
+    namespace {
+
+        // Methods of the blocks, as stored in their header
+        enum Method : uint8_t {
+            Stored = 0,
+            Lz = 1,
+            Lz4 = 2,
+            Zstd = 3,
+        };
+
+        // Set in the method of a block followed by a checksum
+        constexpr uint8_t ChecksumFlag = 0x80;
+
+        // Shortest match worth encoding
+        constexpr std::size_t MinMatch = 4;
+
+        // Farthest match, the offsets are stored on 16 bits
+        constexpr std::size_t MaxOffset = 65535;
+
+        constexpr unsigned HashBits = 14;
+
+        uint32_t load32(const std::byte* p) {
+            uint32_t x;
+            std::memcpy(&x, p, 4);
+            return x;
+        }
+
+        uint32_t hash(uint32_t x) {
+            return (x * 2654435761u) >> (32 - HashBits);
+        }
+
+        void storeBigEndian32(std::byte* out, uint32_t x) {
+            for (int i = 3; i >= 0; --i) {
+                out[3 - i] = static_cast<std::byte>(x >> (8 * i) & 0xFF);
+            }
+        }
+
+        uint32_t loadBigEndian32(const std::byte* in) {
+            uint32_t x = 0;
+            for (int i = 0; i < 4; i++) {
+                x = (x << 8) | std::to_integer<uint32_t>(in[i]);
+            }
+            return x;
+        }
+
+        // Write the extension bytes of a length whose nibble is 15
+        bool writeLength(std::byte*& op, std::byte* end, std::size_t length) {
+            while (length >= 255) {
+                if (op == end) {
+                    return false;
+                }
+                *op++ = std::byte{255};
+                length -= 255;
+            }
+            if (op == end) {
+                return false;
+            }
+            *op++ = static_cast<std::byte>(length);
+            return true;
+        }
+
+        bool readLength(const std::byte*& ip, const std::byte* end, std::size_t& length) {
+            for (;;) {
+                if (ip == end) {
+                    return false;
+                }
+                const auto b = std::to_integer<std::size_t>(*ip++);
+                length += b;
+                if (b != 255) {
+                    return true;
+                }
+            }
+        }
+
+        // Write one sequence: the literals, then the match if `matchLength` is not 0
+        bool writeSequence(std::byte*& op, std::byte* end, const std::byte* literals, std::size_t literalLength, std::size_t offset, std::size_t matchLength) {
+            if (op == end) {
+                return false;
+            }
+
+            std::byte* token = op++;
+            const std::size_t matchCode = matchLength > 0 ? matchLength - MinMatch : 0;
+            *token = static_cast<std::byte>(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+
+            if (literalLength >= 15 && !writeLength(op, end, literalLength - 15)) {
+                return false;
+            }
+
+            if (static_cast<std::size_t>(end - op) < literalLength) {
+                return false;
+            }
+            if (literalLength > 0) {
+                std::memcpy(op, literals, literalLength);
+                op += literalLength;
+            }
+
+            if (matchLength == 0) {
+                return true;
+            }
+
+            if (end - op < 2) {
+                return false;
+            }
+            *op++ = static_cast<std::byte>(offset & 0xFF);
+            *op++ = static_cast<std::byte>(offset >> 8);
+
+            return matchCode < 15 || writeLength(op, end, matchCode - 15);
+        }
+
+    }
+
+    namespace detail {
+
+        std::size_t lzCompress(const std::byte* src, std::size_t size, std::byte* dst, std::size_t capacity) {
+            std::byte* op = dst;
+            std::byte* const end = dst + capacity;
+
+            // positions + 1 of the last occurrence of each hash, 0 when empty
+            std::vector<uint32_t> table(std::size_t(1) << HashBits, 0);
+
+            std::size_t ip = 0;
+            std::size_t anchor = 0;
+            std::size_t misses = 0;
+
+            while (size >= MinMatch && ip <= size - MinMatch) {
+                const uint32_t sequence = load32(src + ip);
+                const uint32_t h = hash(sequence);
+                const std::size_t candidate = table[h];
+                table[h] = static_cast<uint32_t>(ip + 1);
+
+                if (candidate == 0 || ip - (candidate - 1) > MaxOffset || load32(src + candidate - 1) != sequence) {
+                    // skip faster through data that does not compress
+                    ip += 1 + (misses++ >> 6);
+                    continue;
+                }
+
+                const std::size_t ref = candidate - 1;
+                std::size_t length = MinMatch;
+                while (ip + length < size && src[ref + length] == src[ip + length]) {
+                    length++;
+                }
+
+                if (!writeSequence(op, end, src + anchor, ip - anchor, ip - ref, length)) {
+                    return 0;
+                }
+
+                ip += length;
+                anchor = ip;
+                misses = 0;
+            }
+
+            if (!writeSequence(op, end, src + anchor, size - anchor, 0, 0)) {
+                return 0;
+            }
+
+            return op - dst;
+        }
+
+        bool lzDecompress(const std::byte* src, std::size_t size, std::byte* dst, std::size_t rawSize) {
+            const std::byte* ip = src;
+            const std::byte* const ipEnd = src + size;
+            std::byte* op = dst;
+            std::byte* const opEnd = dst + rawSize;
+
+            while (ip < ipEnd) {
+                const auto token = std::to_integer<std::size_t>(*ip++);
+
+                std::size_t literalLength = token >> 4;
+                if (literalLength == 15 && !readLength(ip, ipEnd, literalLength)) {
+                    return false;
+                }
+                if (static_cast<std::size_t>(ipEnd - ip) < literalLength || static_cast<std::size_t>(opEnd - op) < literalLength) {
+                    return false;
+                }
+                if (literalLength > 0) {
+                    std::memcpy(op, ip, literalLength);
+                    ip += literalLength;
+                    op += literalLength;
+                }
+
+                if (ip == ipEnd) {
+                    // the last sequence has no match
+                    break;
+                }
+
+                if (ipEnd - ip < 2) {
+                    return false;
+                }
+                const std::size_t offset = std::to_integer<std::size_t>(ip[0]) | (std::to_integer<std::size_t>(ip[1]) << 8);
+                ip += 2;
+                if (offset == 0 || offset > static_cast<std::size_t>(op - dst)) {
+                    return false;
+                }
+
+                std::size_t matchLength = token & 15;
+                if (matchLength == 15 && !readLength(ip, ipEnd, matchLength)) {
+                    return false;
+                }
+                matchLength += MinMatch;
+                if (static_cast<std::size_t>(opEnd - op) < matchLength) {
+                    return false;
+                }
+
+                const std::byte* match = op - offset;
+                if (offset >= matchLength) {
+                    std::memcpy(op, match, matchLength);
+                    op += matchLength;
+                } else {
+                    // the match overlaps the bytes it produces
+                    for (std::size_t i = 0; i < matchLength; i++) {
+                        *op++ = *match++;
+                    }
+                }
+            }
+
+            return op == opEnd;
+        }
+
+        bool compressionAvailable(Compression compression) {
+            switch (compression) {
+            case Compression::None:
+            case Compression::Lz:
+                return true;
+            case Compression::Lz4:
+#ifdef SERIAL_HAVE_LZ4
+                return true;
+#else
+                return false;
+#endif
+            case Compression::Zstd:
+#ifdef SERIAL_HAVE_ZSTD
+                return true;
+#else
+                return false;
+#endif
+            }
+            return false;
+        }
+
+        void encodeBlock(Compression compression, const std::byte* data, std::size_t size, std::vector<std::byte>& out, bool checksum) {
+            if (size > UINT32_MAX) {
+                throw std::runtime_error("Block too large");
+            }
+
+            const std::size_t headerSize = BlockHeaderSize + (checksum ? ChecksumSize : 0);
+            out.resize(headerSize + size);
+            std::byte* payload = out.data() + headerSize;
+
+            // a compressed block must be smaller than the data to be worth it
+            std::size_t stored = 0;
+            uint8_t method = Stored;
+
+            switch (compression) {
+            case Compression::None:
+                break;
+            case Compression::Lz:
+                stored = lzCompress(data, size, payload, size);
+                method = Lz;
+                break;
+            case Compression::Lz4:
+#ifdef SERIAL_HAVE_LZ4
+                if (size <= static_cast<std::size_t>(LZ4_MAX_INPUT_SIZE)) {
+                    const int res = LZ4_compress_default(reinterpret_cast<const char*>(data), reinterpret_cast<char*>(payload), static_cast<int>(size), static_cast<int>(size));
+                    stored = res > 0 ? static_cast<std::size_t>(res) : 0;
+                }
+                method = Lz4;
+#endif
+                break;
+            case Compression::Zstd:
+#ifdef SERIAL_HAVE_ZSTD
+                {
+                    const std::size_t res = ZSTD_compress(payload, size, data, size, 1);
+                    stored = ZSTD_isError(res) ? 0 : res;
+                }
+                method = Zstd;
+#endif
+                break;
+            }
+
+            if (stored == 0 || stored >= size) {
+                method = Stored;
+                stored = size;
+                std::memcpy(payload, data, size);
+            }
+
+            out[0] = static_cast<std::byte>(checksum ? method | ChecksumFlag : method);
+            storeBigEndian32(out.data() + 1, static_cast<uint32_t>(size));
+            storeBigEndian32(out.data() + 5, static_cast<uint32_t>(stored));
+            out.resize(headerSize + stored);
+
+            if (checksum) {
+                const uint32_t crc = crc32c(crc32c(0, out.data(), BlockHeaderSize), payload, stored);
+                storeBigEndian32(out.data() + BlockHeaderSize, crc);
+            }
+        }
+
+        BlockHeader decodeBlockHeader(const std::byte* data, bool checksum) {
+            BlockHeader header;
+            const auto method = std::to_integer<uint8_t>(data[0]);
+            if (((method & ChecksumFlag) != 0) != checksum) {
+                throw std::runtime_error(checksum ? "Block without checksum" : "Unexpected block checksum");
+            }
+
+            header.method = static_cast<uint8_t>(method & ~ChecksumFlag);
+            header.rawSize = loadBigEndian32(data + 1);
+            header.storedSize = loadBigEndian32(data + 5);
+            header.checksum = checksum ? loadBigEndian32(data + BlockHeaderSize) : 0;
+
+            if (header.method > Zstd) {
+                throw std::runtime_error("Unknown block method");
+            }
+            // a block is only compressed if it gets smaller
+            if (header.storedSize > header.rawSize || (header.method == Stored && header.storedSize != header.rawSize)) {
+                throw std::runtime_error("Corrupted block");
+            }
+            return header;
+        }
+
+        void verifyBlock(const BlockHeader& header, const std::byte* head, const std::byte* payload) {
+            if (crc32c(crc32c(0, head, BlockHeaderSize), payload, header.storedSize) != header.checksum) {
+                throw std::runtime_error("Checksum mismatch");
+            }
+        }
+
+        void decodeBlock(const BlockHeader& header, const std::byte* payload, std::byte* out) {
+            bool ok = false;
+
+            switch (header.method) {
+            case Stored:
+                std::memcpy(out, payload, header.rawSize);
+                ok = true;
+                break;
+            case Lz:
+                ok = lzDecompress(payload, header.storedSize, out, header.rawSize);
+                break;
+            case Lz4:
+#ifdef SERIAL_HAVE_LZ4
+                ok = LZ4_decompress_safe(reinterpret_cast<const char*>(payload), reinterpret_cast<char*>(out), static_cast<int>(header.storedSize), static_cast<int>(header.rawSize)) == static_cast<int>(header.rawSize);
+                break;
+#else
+                throw std::runtime_error("The file uses lz4, which was not compiled in");
+#endif
+            case Zstd:
+#ifdef SERIAL_HAVE_ZSTD
+                ok = ZSTD_decompress(out, header.rawSize, payload, header.storedSize) == header.rawSize;
+                break;
+#else
+                throw std::runtime_error("The file uses zstd, which was not compiled in");
+#endif
+            }
+
+            if (!ok) {
+                throw std::runtime_error("Corrupted block");
+            }
+        }
+
+    } // namespace detail
+
+}
@@ -0,0 +1,102 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Serial.h"
+
+namespace serial {
+
+  namespace detail {
+
+    /**
+     * @brief Size of the header in front of each block of a compressed file
+     *
+     * The header holds the method of the block (1 byte), then the size of
+     * the block before and after compression (4 bytes each, big-endian).
+     * The high bit of the method tells that a checksum follows.
+     */
+    constexpr std::size_t BlockHeaderSize = 9;
+
+    /**
+     * @brief Size of the CRC32C that follows the header of a block of a file
+     * with checksums
+     *
+     * The CRC covers the header and the payload, as stored.
+     */
+    constexpr std::size_t ChecksumSize = 4;
+
+    /**
+     * @brief The header of a block
+     */
+    struct BlockHeader {
+      uint8_t method;
+      uint32_t rawSize;
+      uint32_t storedSize;
+      uint32_t checksum;
+    };
+
+    /**
+     * @brief Tells if the codec was compiled in
+     */
+    bool compressionAvailable(Compression compression);
+
+    /**
+     * @brief Compress `size` bytes pointed by `data` in a block
+     *
+     * The header and the payload of the block are stored in `out`, which is
+     * resized to hold them. The block is stored uncompressed if the codec
+     * does not make it smaller. With `checksum`, the header is followed by
+     * the CRC32C of the block.
+     */
+    void encodeBlock(Compression compression, const std::byte* data, std::size_t size, std::vector<std::byte>& out, bool checksum = false);
+
+    /**
+     * @brief Read a block header, of `BlockHeaderSize` bytes, followed by
+     * `ChecksumSize` bytes if `checksum` is set
+     *
+     * Throws a `std::runtime_error` if the method is unknown, or if the block
+     * does not have a checksum when `checksum` is set or the other way.
+     */
+    BlockHeader decodeBlockHeader(const std::byte* data, bool checksum = false);
+
+    /**
+     * @brief Check the CRC32C of a block whose header has a checksum
+     *
+     * `head` points to the header, as stored. Throws a `std::runtime_error`
+     * if the CRC does not match.
+     */
+    void verifyBlock(const BlockHeader& header, const std::byte* head, const std::byte* payload);
+
+    /**
+     * @brief Decompress the payload of a block in `out`, which must hold
+     * `header.rawSize` bytes
+     *
+     * Throws a `std::runtime_error` if the payload is corrupted or if the
+     * codec was not compiled in.
+     */
+    void decodeBlock(const BlockHeader& header, const std::byte* payload, std::byte* out);
+
+    /**
+     * @brief Compress with the built-in LZ codec
+     *
+     * Returns the size of the compressed data, or 0 if it does not fit in
+     * `capacity` bytes.
+     */
+    std::size_t lzCompress(const std::byte* src, std::size_t size, std::byte* dst, std::size_t capacity);
+
+    /**
+     * @brief Decompress data compressed with `lzCompress()`
+     *
+     * Returns false if the data is corrupted or does not decompress to
+     * exactly `rawSize` bytes.
+     */
+    bool lzDecompress(const std::byte* src, std::size_t size, std::byte* dst, std::size_t rawSize);
+
+  } // namespace detail
+
+} // namespace serial
+
+#endif // COMPRESS_H
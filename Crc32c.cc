@@ -0,0 +1,134 @@
+#include "Crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SERIAL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace serial {
+
+    namespace {
+
+        using Kernel = uint32_t (*)(uint32_t crc, const std::byte* data, std::size_t size);
+
+        // Reversed Castagnoli polynomial
+        constexpr uint32_t Polynomial = 0x82F63B78;
+
+        // The table of slicing by 8: entry [k][b] is the CRC of byte `b`
+        // followed by `k` zero bytes
+        using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+        constexpr Tables makeTables() {
+            Tables tables = {};
+            for (uint32_t b = 0; b < 256; b++) {
+                uint32_t crc = b;
+                for (int i = 0; i < 8; i++) {
+                    crc = (crc >> 1) ^ ((crc & 1) ? Polynomial : 0);
+                }
+                tables[0][b] = crc;
+            }
+            for (std::size_t k = 1; k < 8; k++) {
+                for (uint32_t b = 0; b < 256; b++) {
+                    const uint32_t prev = tables[k - 1][b];
+                    tables[k][b] = (prev >> 8) ^ tables[0][prev & 0xFF];
+                }
+            }
+            return tables;
+        }
+
+        constexpr Tables tables = makeTables();
+
+        uint32_t scalarUpdate(uint32_t crc, const std::byte* data, std::size_t size) {
+            // 8 bytes at a time, in the order of a little-endian load
+            while (size >= 8) {
+                uint32_t lo = crc ^ (std::to_integer<uint32_t>(data[0]) | std::to_integer<uint32_t>(data[1]) << 8
+                    | std::to_integer<uint32_t>(data[2]) << 16 | std::to_integer<uint32_t>(data[3]) << 24);
+                crc = tables[7][lo & 0xFF] ^ tables[6][(lo >> 8) & 0xFF] ^ tables[5][(lo >> 16) & 0xFF] ^ tables[4][lo >> 24]
+                    ^ tables[3][std::to_integer<uint32_t>(data[4])] ^ tables[2][std::to_integer<uint32_t>(data[5])]
+                    ^ tables[1][std::to_integer<uint32_t>(data[6])] ^ tables[0][std::to_integer<uint32_t>(data[7])];
+                data += 8;
+                size -= 8;
+            }
+            while (size > 0) {
+                crc = (crc >> 8) ^ tables[0][(crc ^ std::to_integer<uint32_t>(*data++)) & 0xFF];
+                size--;
+            }
+            return crc;
+        }
+
+#ifdef SERIAL_X86
+
+        // The crc32 instruction of SSE 4.2 uses the Castagnoli polynomial,
+        // and handles 8 bytes per instruction
+
+        __attribute__((target("sse4.2")))
+        uint32_t sse42Update(uint32_t crc, const std::byte* data, std::size_t size) {
+#ifdef __x86_64__
+            uint64_t crc64 = crc;
+            while (size >= 8) {
+                uint64_t x;
+                std::memcpy(&x, data, 8);
+                crc64 = _mm_crc32_u64(crc64, x);
+                data += 8;
+                size -= 8;
+            }
+            crc = static_cast<uint32_t>(crc64);
+#endif
+            while (size >= 4) {
+                uint32_t x;
+                std::memcpy(&x, data, 4);
+                crc = _mm_crc32_u32(crc, x);
+                data += 4;
+                size -= 4;
+            }
+            while (size > 0) {
+                crc = _mm_crc32_u8(crc, std::to_integer<uint8_t>(*data++));
+                size--;
+            }
+            return crc;
+        }
+
+#endif // SERIAL_X86
+
+        struct Selected {
+            Kernel update;
+            const char* name;
+        };
+
+        Selected selectKernel() {
+#ifdef SERIAL_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("sse4.2")) {
+                return { sse42Update, "sse4.2" };
+            }
+#endif
+            return { scalarUpdate, "scalar" };
+        }
+
+        const Selected& kernel() {
+            static const Selected selected = selectKernel();
+            return selected;
+        }
+
+    }
+
+    uint32_t crc32c(uint32_t crc, const std::byte* data, std::size_t size) {
+        return ~kernel().update(~crc, data, size);
+    }
+
+    const char* crc32cKernel() {
+        return kernel().name;
+    }
+
+    namespace detail {
+
+        uint32_t crc32cScalar(uint32_t crc, const std::byte* data, std::size_t size) {
+            return ~scalarUpdate(~crc, data, size);
+        }
+
+    } // namespace detail
+
+}
@@ -0,0 +1,35 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace serial {
+
+  /**
+   * @brief Update the CRC32C (Castagnoli) `crc` of a sequence of bytes with
+   * the `size` bytes pointed by `data`
+   *
+   * The CRC of an empty sequence is 0, so `crc32c(crc32c(0, a, n), b, m)` is
+   * the CRC of `a` followed by `b`. The fastest kernel supported by the CPU
+   * is chosen at the first call.
+   */
+  uint32_t crc32c(uint32_t crc, const std::byte* data, std::size_t size);
+
+  /**
+   * @brief The name of the kernel used by `crc32c()`: "sse4.2" or "scalar"
+   */
+  const char* crc32cKernel();
+
+  namespace detail {
+
+    /**
+     * @brief The portable version of `crc32c()`, whatever the CPU
+     */
+    uint32_t crc32cScalar(uint32_t crc, const std::byte* data, std::size_t size);
+
+  } // namespace detail
+
+} // namespace serial
+
+#endif // CRC32C_H
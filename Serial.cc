@@ -1,146 +1,1225 @@
 #include "Serial.h"
 
+#include "ByteSwap.h"
+#include "Compress.h"
+#include "Shuffle.h"
+
+#include <algorithm>
+#include <atomic>
 #include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <cstring>
 
 #include <stdexcept>
 
-#include "gtest/gtest-printers.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef SERIAL_HAVE_URING
+#include <liburing.h>
+#endif
 
 namespace serial {
 
-    OBinaryFile::OBinaryFile(const std::string& filename, Mode mode) : file_(nullptr) {
-        const char* open_mode = (mode == Truncate) ? "wb" : "ab";
-        file_ = ::fopen(filename.c_str(), open_mode);
+    namespace {
+
+        using detail::HostIsBigEndian;
+
+        // Size of the scratch buffer used to encode sequences of values
+        constexpr std::size_t BulkChunkSize = 16 * 1024;
+
+        // Reverse the bytes of `count` values of type `T`
+        template<typename T>
+        void byteSwapArray(std::byte* dst, const std::byte* src, std::size_t count) {
+            if constexpr (sizeof(T) == 2) {
+                byteSwap16(dst, src, count);
+            } else if constexpr (sizeof(T) == 4) {
+                byteSwap32(dst, src, count);
+            } else {
+                static_assert(sizeof(T) == 8, "unsupported size");
+                byteSwap64(dst, src, count);
+            }
+        }
+
+        // Longest LEB128 encoding of a 64 bits value
+        constexpr std::size_t MaxVarintSize = 10;
+
+        // Write `x` as a LEB128 varint at `out`, returns the number of bytes used
+        std::size_t encodeVarint(std::byte* out, uint64_t x) {
+            std::size_t size = 0;
+            while (x >= 0x80) {
+                out[size++] = static_cast<std::byte>(x | 0x80);
+                x >>= 7;
+            }
+            out[size++] = static_cast<std::byte>(x);
+            return size;
+        }
+
+        using detail::toVarint;
+        using detail::fromVarint;
+
+        // Decode a varint of up to 8 bytes at once if there are 8 bytes
+        // left: find the last byte from the continuation bits, then pack the
+        // 7 bits groups. Returns false if the slow path is needed.
+        bool decodeVarintFast(const std::byte*& pos, const std::byte* end, uint64_t& x) {
+            if (static_cast<std::size_t>(end - pos) < 8) {
+                return false;
+            }
+
+            uint64_t word;
+            std::memcpy(&word, pos, 8);
+            if constexpr (HostIsBigEndian) {
+                word = __builtin_bswap64(word);
+            }
+
+            const uint64_t stops = ~word & 0x8080808080808080;
+            if (stops == 0) {
+                return false;
+            }
+
+            const unsigned length = __builtin_ctzll(stops) / 8 + 1;
+            x = word & 0x7f7f7f7f7f7f7f7f;
+            if (length < 8) {
+                x &= (uint64_t(1) << (8 * length)) - 1;
+            }
+            x = ((x & 0x7f007f007f007f00) >> 1) | (x & 0x007f007f007f007f);
+            x = ((x & 0x3fff00003fff0000) >> 2) | (x & 0x00003fff00003fff);
+            x = ((x & 0x0fffffff00000000) >> 4) | (x & 0x000000000fffffff);
+            pos += length;
+            return true;
+        }
+
+        // Read a LEB128 varint from memory and move `data` after it
+        uint64_t decodeVarint(const std::byte*& data, const std::byte* end) {
+            uint64_t x = 0;
+            for (unsigned shift = 0; shift < 7 * MaxVarintSize; shift += 7) {
+                if (data == end) {
+                    throw std::runtime_error("Truncated varint");
+                }
+
+                const auto bits = std::to_integer<uint64_t>(*data++);
+                x |= (bits & 0x7f) << shift;
+                if ((bits & 0x80) == 0) {
+                    return x;
+                }
+            }
+
+            throw std::runtime_error("Invalid varint");
+        }
+
+        // The table of contents of the sections ends with the number of
+        // sections, the offset of the table and this magic, 8 bytes each
+        constexpr char SectionMagic[8] = { 'S', 'E', 'R', 'I', 'A', 'L', 'T', 'C' };
+        constexpr std::size_t SectionTrailerSize = 24;
+
+        void storeBigEndian64(std::byte* out, uint64_t x) {
+            for (int i = 7; i >= 0; --i) {
+                out[7 - i] = static_cast<std::byte>(x >> (8 * i) & 0xFF);
+            }
+        }
+
+        uint64_t loadBigEndian64(const std::byte* in) {
+            uint64_t x = 0;
+            for (int i = 0; i < 8; i++) {
+                x = (x << 8) | std::to_integer<uint64_t>(in[i]);
+            }
+            return x;
+        }
+
+        // The header of a file: this magic, the version of the format, the
+        // byte order of the writer (0 for little-endian, 1 for big-endian),
+        // the encoding, the compression, and 4 bytes of flags, big-endian
+        constexpr char HeaderMagic[8] = { 'S', 'E', 'R', 'I', 'A', 'L', 'F', 'H' };
+        constexpr std::size_t HeaderSize = 16;
+        constexpr uint8_t FormatVersion = 1;
+
+        // The blocks have checksums
+        constexpr uint32_t ChecksumFlag = 1;
+
+        void encodeHeader(std::byte* out, Encoding encoding, Compression compression, bool checksum) {
+            std::memcpy(out, HeaderMagic, sizeof(HeaderMagic));
+            out[8] = static_cast<std::byte>(FormatVersion);
+            out[9] = static_cast<std::byte>(HostIsBigEndian ? 1 : 0);
+            out[10] = static_cast<std::byte>(encoding);
+            out[11] = static_cast<std::byte>(compression);
+            std::memset(out + 12, 0, 4);
+            out[15] = static_cast<std::byte>(checksum ? ChecksumFlag : 0);
+        }
+
+        // `swapsFloats` tells if the writer had the other byte order: the
+        // integers do not depend on it, but the floating point values do
+        void decodeHeader(const std::byte* in, std::size_t size, Encoding& encoding, Compression& compression, bool& checksum, bool& swapsFloats) {
+            if (size < HeaderSize || std::memcmp(in, HeaderMagic, sizeof(HeaderMagic)) != 0) {
+                throw std::runtime_error("Missing file header");
+            }
+            if (std::to_integer<uint8_t>(in[8]) > FormatVersion) {
+                throw std::runtime_error("Unsupported format version");
+            }
+            const auto byteOrder = std::to_integer<uint8_t>(in[9]);
+            const auto encodingValue = std::to_integer<uint8_t>(in[10]);
+            const auto compressionValue = std::to_integer<uint8_t>(in[11]);
+            if (byteOrder > 1 || encodingValue > static_cast<uint8_t>(Encoding::LittleEndian) || compressionValue > static_cast<uint8_t>(Compression::Zstd)) {
+                throw std::runtime_error("Corrupted file header");
+            }
+            encoding = static_cast<Encoding>(encodingValue);
+            compression = static_cast<Compression>(compressionValue);
+            checksum = (std::to_integer<uint32_t>(in[15]) & ChecksumFlag) != 0;
+            swapsFloats = byteOrder != (HostIsBigEndian ? 1 : 0);
+        }
+
+#ifdef SERIAL_STATS
+        uint64_t elapsedNanoseconds(std::chrono::steady_clock::time_point start) {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        // Make a call to the system and count it, with the bytes it moved
+        // and the time it took
+        template<typename Call>
+        auto countIo(Stats* stats, Call call) {
+            const auto start = std::chrono::steady_clock::now();
+            const auto res = call();
+            stats->blockedNanoseconds += elapsedNanoseconds(start);
+            stats->ioCalls++;
+            if (res > 0) {
+                stats->ioBytes += static_cast<uint64_t>(res);
+            }
+            return res;
+        }
+
+// The counters are not even evaluated when the stats are compiled out
+#define SERIAL_IO(stats, call) countIo((stats), [&]() { return (call); })
+#define SERIAL_STATS_OF(stats) (&(stats))
+#else
+#define SERIAL_IO(stats, call) (call)
+#define SERIAL_STATS_OF(stats) static_cast<Stats*>(nullptr)
+#endif
+
+        // Alignment of the buffers, and of the offsets and sizes of the direct I/O
+        constexpr std::size_t DirectAlignment = 4096;
+
+        // Bytes written or read between two evictions from the page cache
+        constexpr uint64_t DropWindow = uint64_t(64) << 20;
+
+        std::size_t alignUp(std::size_t size) {
+            return (size + DirectAlignment - 1) / DirectAlignment * DirectAlignment;
+        }
+
+        detail::Buffer allocateBuffer(std::size_t size) {
+            return detail::Buffer(static_cast<std::byte*>(::operator new[](size, std::align_val_t(DirectAlignment))));
+        }
+
+        // Open with O_DIRECT if asked, or without it if the file system does not support it
+        int openFile(const std::string& filename, int flags, bool direct) {
+#ifdef O_DIRECT
+            if (direct) {
+                const int fd = ::open(filename.c_str(), flags | O_DIRECT, 0666);
+                if (fd >= 0 || errno != EINVAL) {
+                    return fd;
+                }
+            }
+#endif
+            return ::open(filename.c_str(), flags, 0666);
+        }
+
+        // Write the `size` bytes pointed by `data` at `offset`
+        bool writeAt(int fd, const std::byte* data, std::size_t size, uint64_t offset, [[maybe_unused]] Stats* stats) {
+            while (size > 0) {
+                const ssize_t res = SERIAL_IO(stats, ::pwrite(fd, data, size, static_cast<off_t>(offset)));
+                if (res < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (res <= 0) {
+                    return false;
+                }
+                data += res;
+                size -= static_cast<std::size_t>(res);
+                offset += static_cast<uint64_t>(res);
+            }
+            return true;
+        }
+
+        // Evict the bytes from `from` to `to` from the page cache, writing
+        // them back first if they are `dirty`. The hints may be ignored.
+        void evictPages(int fd, uint64_t from, uint64_t to, bool dirty) {
+            if (to <= from) {
+                return;
+            }
+            if (dirty) {
+#ifdef __linux__
+                ::sync_file_range(fd, static_cast<off_t>(from), static_cast<off_t>(to - from),
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#else
+                ::fdatasync(fd);
+#endif
+            }
+            ::posix_fadvise(fd, static_cast<off_t>(from), static_cast<off_t>(to - from), POSIX_FADV_DONTNEED);
+        }
+
+        // Write `size` bytes in the file, in a block unless `compression` is
+        // `None` and there is no `checksum`. `block` is the scratch buffer of
+        // the block.
+        bool writeBlock(FILE* file, Compression compression, bool checksum, std::vector<std::byte>& block, const std::byte* data, std::size_t size, [[maybe_unused]] Stats* stats) {
+            if (compression == Compression::None && !checksum) {
+                return SERIAL_IO(stats, std::fwrite(data, 1, size, file)) == size;
+            }
+
+            detail::encodeBlock(compression, data, size, block, checksum);
+            return SERIAL_IO(stats, std::fwrite(block.data(), 1, block.size(), file)) == block.size();
+        }
+
+    }
+
+    namespace detail {
+
+        /**
+         * @brief The background thread of an asynchronous `OBinaryFile`
+         *
+         * The thread writes one buffer while the file fills the other one.
+         */
+        class AsyncWriter {
+        public:
+            AsyncWriter(FILE* file, std::size_t capacity, Compression compression, bool checksum) :
+            file_(file), compression_(compression), checksum_(checksum), pendingSize_(0), hasPending_(false), stop_(false),
+            spare_(allocateBuffer(capacity)) {
+                thread_ = std::thread([this]() { run(); });
+            }
+
+            // Waits for the last buffer to be written
+            ~AsyncWriter() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stop_ = true;
+                }
+                cv_.notify_all();
+                thread_.join();
+            }
+
+            AsyncWriter(const AsyncWriter& other) = delete;
+            AsyncWriter& operator=(const AsyncWriter& other) = delete;
+
+            // Hand the first `size` bytes of `buffer` to the thread and
+            // replace it with an empty buffer, waits while the thread writes
+            // the previous one. If the thread ever failed, `buffer` is left
+            // as it was and the error is thrown
+            void submit(Buffer& buffer, std::size_t size) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                waitWritten(lock);
+                throwError();
+
+                pending_ = std::move(buffer);
+                pendingSize_ = size;
+                hasPending_ = true;
+                cv_.notify_all();
+                buffer = std::move(spare_);
+            }
+
+            // Wait until every submitted buffer is written
+            void wait() {
+                std::unique_lock<std::mutex> lock(mutex_);
+                waitWritten(lock);
+                throwError();
+            }
+
+            // The calls made by the thread, and the time the file waited for it
+            Stats stats() const {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return stats_;
+            }
+
+        private:
+            void waitWritten(std::unique_lock<std::mutex>& lock) {
+#ifdef SERIAL_STATS
+                if (hasPending_) {
+                    const auto start = std::chrono::steady_clock::now();
+                    cv_.wait(lock, [this]() { return !hasPending_; });
+                    stats_.blockedNanoseconds += elapsedNanoseconds(start);
+                }
+#else
+                cv_.wait(lock, [this]() { return !hasPending_; });
+#endif
+            }
+
+            void run() {
+                std::unique_lock<std::mutex> lock(mutex_);
+                for (;;) {
+                    cv_.wait(lock, [this]() { return hasPending_ || stop_; });
+                    if (!hasPending_) {
+                        return;
+                    }
+
+                    // pending_ is not touched by the file while hasPending_ is
+                    // set, and the blocks are compressed here too
+                    Stats stats;
+                    lock.unlock();
+                    const bool ok = writeBlock(file_, compression_, checksum_, block_, pending_.get(), pendingSize_, SERIAL_STATS_OF(stats));
+                    lock.lock();
+
+#ifdef SERIAL_STATS
+                    // the time the thread spends writing is not time the file waits
+                    stats_.ioCalls += stats.ioCalls;
+                    stats_.ioBytes += stats.ioBytes;
+#endif
+
+                    if (!ok && error_.empty()) {
+                        error_ = "Failed to write all bytes to file";
+                    }
+                    spare_ = std::move(pending_);
+                    hasPending_ = false;
+                    cv_.notify_all();
+                }
+            }
+
+            // The error stays: a buffer was lost, so every later submit and
+            // wait fails too
+            void throwError() {
+                if (!error_.empty()) {
+                    throw std::runtime_error(error_);
+                }
+            }
+
+            FILE* file_;
+            Compression compression_;
+            bool checksum_;
+            std::vector<std::byte> block_;
+            mutable std::mutex mutex_;
+            std::condition_variable cv_;
+            Buffer pending_;
+            std::size_t pendingSize_;
+            bool hasPending_;
+            bool stop_;
+            Buffer spare_;
+            std::string error_;
+            Stats stats_;
+            std::thread thread_;
+        };
+
+        /**
+         * @brief The read-ahead of a buffered `IBinaryFile`
+         *
+         * The file is read in chunks of `chunkSize` bytes, aligned for the
+         * direct I/O, and the `depth` chunks that follow the one being decoded
+         * are loaded meanwhile. With io_uring, their reads are in flight
+         * together. Otherwise a thread makes them one after the other.
+         */
+        class ReadAhead {
+        public:
+            ReadAhead(int fd, std::size_t chunkSize, std::size_t depth) :
+            fd_(fd), chunkSize_(chunkSize), slots_(depth + 1), head_(0), load_(0), next_(0), skip_(0), held_(false),
+            pos_(nullptr), end_(nullptr), offset_(0), uring_(false), inFlight_(0), stop_(false) {
+                for (auto& slot : slots_) {
+                    slot.data = allocateBuffer(chunkSize);
+                }
+#ifdef SERIAL_HAVE_URING
+                // the kernel or a seccomp filter may refuse the ring
+                uring_ = ::io_uring_queue_init(static_cast<unsigned>(slots_.size()), &ring_, 0) == 0;
+#endif
+                if (!uring_) {
+                    thread_ = std::thread([this]() { run(); });
+                }
+                std::unique_lock<std::mutex> lock(mutex_);
+                restart(lock, 0);
+            }
+
+            // Waits for the reads in flight, they write in the chunks
+            ~ReadAhead() {
+#ifdef SERIAL_HAVE_URING
+                if (uring_) {
+                    while (inFlight_ > 0 && complete()) { }
+                    ::io_uring_queue_exit(&ring_);
+                    return;
+                }
+#endif
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stop_ = true;
+                }
+                cv_.notify_all();
+                thread_.join();
+            }
+
+            ReadAhead(const ReadAhead& other) = delete;
+            ReadAhead& operator=(const ReadAhead& other) = delete;
+
+            // Hand out the rest of the current chunk, or the next one once it
+            // is loaded. The bytes stay valid until the next call. Returns 0
+            // at the end of the file.
+            std::size_t next(const std::byte*& data) {
+                if (pos_ == end_ && !advance()) {
+                    data = pos_;
+                    return 0;
+                }
+                data = pos_;
+                const std::size_t size = end_ - pos_;
+                pos_ = end_;
+                offset_ += size;
+                return size;
+            }
+
+            // Copy the next bytes, returns less than `size` at the end of the file
+            std::size_t read(std::byte* data, std::size_t size) {
+                std::size_t done = 0;
+                while (done < size) {
+                    if (pos_ == end_ && !advance()) {
+                        break;
+                    }
+                    const std::size_t n = std::min<std::size_t>(end_ - pos_, size - done);
+                    std::memcpy(data + done, pos_, n);
+                    pos_ += n;
+                    done += n;
+                    offset_ += n;
+                }
+                return done;
+            }
+
+            // Continue from `offset`, the chunks loaded ahead are dropped
+            // unless it is in one of them
+            void seek(uint64_t offset) {
+                if (held_ && offset >= offset_ && offset - offset_ <= static_cast<uint64_t>(end_ - pos_)) {
+                    pos_ += offset - offset_;
+                    offset_ = offset;
+                    return;
+                }
+
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (moveTo(lock, offset)) {
+                    start();
+                    return;
+                }
+                restart(lock, offset);
+            }
+
+            // The offset of the next byte handed out
+            uint64_t offset() const {
+                return offset_;
+            }
+
+            // The reads, and the time the file waited for them
+            Stats stats() const {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return stats_;
+            }
+
+        private:
+            enum class State {
+                Queued,
+                Loading,
+                Ready,
+            };
+
+            struct Slot {
+                Buffer data;
+                uint64_t offset = 0;
+                std::size_t size = 0;
+                State state = State::Ready;
+                bool failed = false;
+            };
+
+            // Drop the chunks and load them again from `offset`
+            void restart(std::unique_lock<std::mutex>& lock, uint64_t offset) {
+                drain(lock);
+
+                const uint64_t aligned = offset / DirectAlignment * DirectAlignment;
+                for (std::size_t i = 0; i < slots_.size(); i++) {
+                    queue(slots_[i], aligned + i * chunkSize_);
+                }
+                next_ = aligned + slots_.size() * chunkSize_;
+                head_ = 0;
+                load_ = 0;
+                held_ = false;
+                pos_ = nullptr;
+                end_ = nullptr;
+                skip_ = static_cast<std::size_t>(offset - aligned);
+                offset_ = offset;
+                start();
+            }
+
+            void queue(Slot& slot, uint64_t offset) {
+                slot.offset = offset;
+                slot.size = 0;
+                slot.state = State::Queued;
+                slot.failed = false;
+            }
+
+            // The chunks from `head_` on follow each other in the file. If
+            // `offset` is in one of them, the ones before it are loaded
+            // again after the others and it becomes the current one.
+            // Returns false if `offset` is not in the chunks.
+            bool moveTo(std::unique_lock<std::mutex>& lock, uint64_t offset) {
+                const uint64_t first = slots_[head_].offset;
+                if (offset < first || (offset - first) / chunkSize_ >= slots_.size()) {
+                    return false;
+                }
+
+                const auto count = static_cast<std::size_t>((offset - first) / chunkSize_);
+                for (std::size_t i = 0; i < count; i++) {
+                    Slot& slot = slots_[head_];
+                    if (slot.state == State::Loading) {
+                        // a read writes in it, a queued chunk is just moved
+                        wait(lock, slot);
+                    }
+                    queue(slot, next_);
+                    next_ += chunkSize_;
+                    head_ = (head_ + 1) % slots_.size();
+                }
+
+                held_ = false;
+                pos_ = nullptr;
+                end_ = nullptr;
+                skip_ = static_cast<std::size_t>(offset - slots_[head_].offset);
+                offset_ = offset;
+                return true;
+            }
+
+            // Give the current chunk back to be loaded again, after the
+            // others, and wait for the next one
+            bool advance() {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (held_) {
+                    Slot& slot = slots_[head_];
+                    if (slot.size == 0) {
+                        // the end of the file
+                        return false;
+                    }
+                    queue(slot, next_);
+                    next_ += chunkSize_;
+                    head_ = (head_ + 1) % slots_.size();
+                    held_ = false;
+                    start();
+                }
+
+                Slot& slot = slots_[head_];
+                wait(lock, slot);
+                if (slot.failed) {
+                    throw std::runtime_error("Failed to read all bytes from file");
+                }
+
+                held_ = true;
+                end_ = slot.data.get() + slot.size;
+                pos_ = slot.data.get() + std::min(skip_, slot.size);
+                skip_ = 0;
+                return pos_ < end_;
+            }
+
+            // Start the reads of the queued chunks
+            void start() {
+#ifdef SERIAL_HAVE_URING
+                if (uring_) {
+                    submit();
+                    return;
+                }
+#endif
+                cv_.notify_all();
+            }
+
+            void wait(std::unique_lock<std::mutex>& lock, Slot& slot) {
+                if (slot.state == State::Ready) {
+                    return;
+                }
+#ifdef SERIAL_STATS
+                const auto start = std::chrono::steady_clock::now();
+#endif
+#ifdef SERIAL_HAVE_URING
+                if (uring_) {
+                    while (slot.state != State::Ready) {
+                        submit();
+                        if (!complete()) {
+                            throw std::runtime_error("Failed to read all bytes from file");
+                        }
+                    }
+                } else
+#endif
+                {
+                    cv_.wait(lock, [&slot]() { return slot.state == State::Ready; });
+                }
+#ifdef SERIAL_STATS
+                stats_.blockedNanoseconds += elapsedNanoseconds(start);
+#endif
+            }
+
+            // Wait until no read writes in the chunks
+            void drain([[maybe_unused]] std::unique_lock<std::mutex>& lock) {
+#ifdef SERIAL_HAVE_URING
+                if (uring_) {
+                    while (inFlight_ > 0) {
+                        if (!complete()) {
+                            throw std::runtime_error("Failed to read all bytes from file");
+                        }
+                    }
+                    return;
+                }
+#endif
+                cv_.wait(lock, [this]() { return slots_[load_].state != State::Loading; });
+            }
+
+            // The thread loads the queued chunks in order
+            void run() {
+                std::unique_lock<std::mutex> lock(mutex_);
+                for (;;) {
+                    cv_.wait(lock, [this]() { return stop_ || slots_[load_].state == State::Queued; });
+                    if (stop_) {
+                        return;
+                    }
+
+                    // the slot is not touched by the file while it is loading
+                    Slot& slot = slots_[load_];
+                    slot.state = State::Loading;
+                    Stats stats;
+                    lock.unlock();
+                    const bool ok = load(slot, SERIAL_STATS_OF(stats));
+                    lock.lock();
+
+#ifdef SERIAL_STATS
+                    stats_.ioCalls += stats.ioCalls;
+                    stats_.ioBytes += stats.ioBytes;
+#endif
+
+                    slot.failed = !ok;
+                    slot.state = State::Ready;
+                    load_ = (load_ + 1) % slots_.size();
+                    cv_.notify_all();
+                }
+            }
+
+            // Read a whole chunk, or up to the end of the file
+            bool load(Slot& slot, [[maybe_unused]] Stats* stats) {
+                while (slot.size < chunkSize_) {
+                    const ssize_t res = SERIAL_IO(stats, ::pread(fd_, slot.data.get() + slot.size, chunkSize_ - slot.size, static_cast<off_t>(slot.offset + slot.size)));
+                    if (res < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (res < 0) {
+                        return false;
+                    }
+                    if (res == 0) {
+                        break;
+                    }
+                    slot.size += static_cast<std::size_t>(res);
+                }
+                return true;
+            }
+
+#ifdef SERIAL_HAVE_URING
+            // Put the reads of the queued chunks in flight
+            void submit() {
+                for (auto& slot : slots_) {
+                    if (slot.state != State::Queued) {
+                        continue;
+                    }
+                    io_uring_sqe* sqe = ::io_uring_get_sqe(&ring_);
+                    if (sqe == nullptr) {
+                        break;
+                    }
+                    ::io_uring_prep_read(sqe, fd_, slot.data.get() + slot.size, static_cast<unsigned>(chunkSize_ - slot.size), slot.offset + slot.size);
+                    ::io_uring_sqe_set_data(sqe, &slot);
+                    slot.state = State::Loading;
+                }
+
+                while (::io_uring_sq_ready(&ring_) > 0) {
+                    const int res = ::io_uring_submit(&ring_);
+                    if (res == -EINTR) {
+                        continue;
+                    }
+                    if (res <= 0) {
+                        throw std::runtime_error("Failed to read all bytes from file");
+                    }
+                    inFlight_ += static_cast<std::size_t>(res);
+#ifdef SERIAL_STATS
+                    stats_.ioCalls++;
+#endif
+                }
+            }
+
+            // Wait for the end of one read, returns false if the ring fails
+            bool complete() {
+                io_uring_cqe* cqe;
+                int res;
+                do {
+                    res = ::io_uring_wait_cqe(&ring_, &cqe);
+                } while (res == -EINTR);
+                if (res < 0) {
+                    return false;
+                }
+
+                Slot& slot = *static_cast<Slot*>(::io_uring_cqe_get_data(cqe));
+                const int got = cqe->res;
+                ::io_uring_cqe_seen(&ring_, cqe);
+                inFlight_--;
+
+                if (got == -EINTR || got == -EAGAIN) {
+                    // read again at the next submission
+                    slot.state = State::Queued;
+                } else if (got < 0) {
+                    slot.failed = true;
+                    slot.state = State::Ready;
+                } else {
+#ifdef SERIAL_STATS
+                    stats_.ioBytes += static_cast<uint64_t>(got);
+#endif
+                    // a short read is continued, unless it is the end of the file
+                    slot.size += static_cast<std::size_t>(got);
+                    slot.state = got == 0 || slot.size == chunkSize_ ? State::Ready : State::Queued;
+                }
+                return true;
+            }
+
+            io_uring ring_;
+#endif
+
+            int fd_;
+            std::size_t chunkSize_;
+            // a ring of chunks, the one at head_ is decoded and the others load
+            std::vector<Slot> slots_;
+            std::size_t head_;
+            std::size_t load_;
+            uint64_t next_;
+            std::size_t skip_;
+            bool held_;
+            const std::byte* pos_;
+            const std::byte* end_;
+            uint64_t offset_;
+            bool uring_;
+            std::size_t inFlight_;
+            mutable std::mutex mutex_;
+            std::condition_variable cv_;
+            bool stop_;
+            Stats stats_;
+            std::thread thread_;
+        };
+
+        void AlignedDelete::operator()(std::byte* data) const {
+            ::operator delete[](data, std::align_val_t(DirectAlignment));
+        }
+
+    } // namespace detail
+
+    OBinaryFile::OBinaryFile(const std::string& filename, Mode mode, const Options& options) :
+    file_(nullptr), pos_(nullptr), end_(nullptr), encoding_(options.encoding), compression_(options.compression), checksum_(options.checksum),
+    direct_(options.direct), dropCache_(options.dropCache), offset_(0), dropFrom_(0), inSection_(false) {
+        if (!detail::compressionAvailable(compression_)) {
+            throw std::runtime_error("This compression was not compiled in");
+        }
+
+        // the blocks and the thread write buffers of any size
+        const bool blocks = compression_ != Compression::None || checksum_;
+        if (direct_ && (blocks || options.async)) {
+            throw std::runtime_error("Direct I/O does not support compression, checksums or async");
+        }
+
+        if (direct_) {
+            // pwrite() would ignore the offsets with O_APPEND, they are
+            // tracked instead, and the last block of the file may be read back
+            const int fd = openFile(filename, O_RDWR | O_CREAT | O_CLOEXEC | (mode == Truncate ? O_TRUNC : 0), true);
+            file_ = fd >= 0 ? ::fdopen(fd, "wb") : nullptr;
+            if (fd >= 0 && !file_) {
+                ::close(fd);
+            }
+        } else {
+            const char* open_mode = (mode == Truncate) ? "wb" : "ab";
+            file_ = ::fopen(filename.c_str(), open_mode);
+        }
         if (!file_) {
             throw std::runtime_error("Cannot open file " + filename);
         }
+
+        // the asynchronous mode needs buffers to hand to the thread, the
+        // blocks a buffer the size of a block, and the direct I/O aligned
+        // buffers
+        const bool needsBuffer = options.async || blocks || direct_;
+        std::size_t bufferSize = (needsBuffer && options.bufferSize == 0) ? DefaultBufferSize : options.bufferSize;
+        if (direct_) {
+            bufferSize = alignUp(bufferSize);
+        }
+
+        if (blocks && bufferSize > UINT32_MAX) {
+            ::fclose(file_);
+            file_ = nullptr;
+            throw std::runtime_error("Blocks are limited to 4 GiB");
+        }
+
+        if (bufferSize > 0) {
+            // stdio would only copy our already large writes once more
+            std::setvbuf(file_, nullptr, _IONBF, 0);
+            buffer_ = allocateBuffer(bufferSize);
+            pos_ = buffer_.get();
+            end_ = pos_ + bufferSize;
+        }
+
+        const int fd = ::fileno(file_);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::fclose(file_);
+            file_ = nullptr;
+            throw std::runtime_error("Cannot open file " + filename);
+        }
+        const auto size = static_cast<uint64_t>(st.st_size);
+        offset_ = size;
+        dropFrom_ = size;
+
+#ifdef __linux__
+        if (options.preallocate > 0) {
+            // only a hint, the writes allocate the blocks anyway
+            ::fallocate(fd, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(size), static_cast<off_t>(options.preallocate));
+        }
+#endif
+
+        try {
+            if (direct_ && size % DirectAlignment != 0) {
+                // the last block of the file is written again with the new bytes
+                const std::size_t tail = size % DirectAlignment;
+                offset_ = size - tail;
+                if (SERIAL_IO(&stats_, ::pread(fd, buffer_.get(), DirectAlignment, static_cast<off_t>(offset_))) < static_cast<ssize_t>(tail)) {
+                    throw std::runtime_error("Failed to read all bytes from file");
+                }
+                pos_ += tail;
+            }
+
+            if (options.header && size == 0) {
+                // the header is never compressed, the reader needs it to decode the blocks
+                std::byte header[HeaderSize];
+                encodeHeader(header, encoding_, compression_, checksum_);
+                writeToFile(header, HeaderSize);
+            }
+        } catch (const std::runtime_error&) {
+            ::fclose(file_);
+            file_ = nullptr;
+            throw;
+        }
+
+        if (options.async) {
+            async_ = std::make_unique<detail::AsyncWriter>(file_, bufferSize, compression_, checksum_);
+        }
     }
 
     OBinaryFile::~OBinaryFile() {
-        if (file_) {
-            fclose(file_);
-            file_ = nullptr;
+        try {
+            close();
+        } catch (const std::runtime_error&) {
+            // a destructor must not throw, call close() to get the error
         }
     }
 
     OBinaryFile::OBinaryFile(OBinaryFile&& other) noexcept :
-    file_(std::exchange(other.file_, nullptr)) { }
+    file_(std::exchange(other.file_, nullptr)),
+    buffer_(std::move(other.buffer_)),
+    pos_(std::exchange(other.pos_, nullptr)),
+    end_(std::exchange(other.end_, nullptr)),
+    encoding_(other.encoding_),
+    compression_(other.compression_),
+    checksum_(other.checksum_),
+    direct_(other.direct_),
+    dropCache_(other.dropCache_),
+    offset_(other.offset_),
+    dropFrom_(other.dropFrom_),
+    block_(std::move(other.block_)),
+    async_(std::move(other.async_)),
+    sections_(std::move(other.sections_)),
+    inSection_(std::exchange(other.inSection_, false))
+#ifdef SERIAL_STATS
+    , stats_(std::exchange(other.stats_, Stats()))
+#endif
+    { }
 
     OBinaryFile& OBinaryFile::operator=(OBinaryFile&& other) noexcept {
         if (this != &other) {
-            if (file_) {
-                fclose(file_);
+            try {
+                close();
+            } catch (const std::runtime_error&) {
+                // same as the destructor
             }
             file_ = std::exchange(other.file_, nullptr);
+            buffer_ = std::move(other.buffer_);
+            pos_ = std::exchange(other.pos_, nullptr);
+            end_ = std::exchange(other.end_, nullptr);
+            encoding_ = other.encoding_;
+            compression_ = other.compression_;
+            checksum_ = other.checksum_;
+            direct_ = other.direct_;
+            dropCache_ = other.dropCache_;
+            offset_ = other.offset_;
+            dropFrom_ = other.dropFrom_;
+            block_ = std::move(other.block_);
+            async_ = std::move(other.async_);
+            sections_ = std::move(other.sections_);
+            inSection_ = std::exchange(other.inSection_, false);
+#ifdef SERIAL_STATS
+            stats_ = std::exchange(other.stats_, Stats());
+#endif
         }
         return *this;
     }
 
-    // Write implementation
-    std::size_t OBinaryFile::write(const std::byte* data, std::size_t size) {
+    void OBinaryFile::flush() {
         if (!file_) {
             throw std::runtime_error("No file opened");
         }
 
-        const std::size_t written_bytes = std::fwrite(data, 1, size, file_);
-        if (written_bytes != size) {
-            throw std::runtime_error("Failed to write all bytes to file");
+        if (direct_) {
+            flushDirect();
+        } else {
+            sendBuffer();
+            if (async_) {
+                async_->wait();
+            }
         }
-        return written_bytes;
-    }
 
-    OBinaryFile& operator<<(OBinaryFile &file, uint8_t &x) {
-        file.write(reinterpret_cast<const std::byte*>(&x), sizeof(x));
-        return file;
+#ifdef SERIAL_STATS
+        stats_.flushes++;
+#endif
+        if (SERIAL_IO(&stats_, std::fflush(file_)) != 0) {
+            throw std::runtime_error("Failed to flush file");
+        }
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, int8_t x) {
-        file.write(reinterpret_cast<const std::byte*>(&x), sizeof(x));
-        return file;
+    Stats OBinaryFile::stats() const {
+#ifdef SERIAL_STATS
+        Stats stats = stats_;
+        if (async_) {
+            const Stats thread = async_->stats();
+            stats.ioCalls += thread.ioCalls;
+            stats.ioBytes += thread.ioBytes;
+            stats.blockedNanoseconds += thread.blockedNanoseconds;
+        }
+        return stats;
+#else
+        return Stats();
+#endif
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, uint16_t x) {
-        std::byte data[2];
-        data[0] = static_cast<std::byte>(x >> 8 & 0xFF);
-        data[1] = static_cast<std::byte>(x & 0xFF);
-        file.write(data, 2);
-        return file;
+    void OBinaryFile::close() {
+        if (!file_) {
+            return;
+        }
+
+        std::string error;
+        try {
+            flush();
+            writeSections();
+            if (dropCache_) {
+                dropPages(true);
+            }
+        } catch (const std::runtime_error& e) {
+            error = e.what();
+        }
+
+        async_.reset();
+        if (std::fclose(file_) != 0 && error.empty()) {
+            error = "Failed to close file";
+        }
+        file_ = nullptr;
+        buffer_.reset();
+        pos_ = nullptr;
+        end_ = nullptr;
+        sections_.clear();
+        inSection_ = false;
+
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, int16_t x) {
-        std::byte data[2];
-        data[0] = static_cast<std::byte>(x >> 8 & 0xFF);
-        data[1] = static_cast<std::byte>(x & 0xFF);
-        file.write(data, 2);
-        return file;
+    void OBinaryFile::beginSection(const std::string& name) {
+        endSection();
+
+        for (const auto& section : sections_) {
+            if (section.name == name) {
+                throw std::runtime_error("Duplicate section " + name);
+            }
+        }
+
+        // the section starts with a new block so that a reader can decode it
+        flush();
+        sections_.push_back({ name, tell(), 0 });
+        inSection_ = true;
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, uint32_t x) {
-        std::byte data[4];
-        for (int i = 3; i >= 0; --i) {
-            data[3-i] = static_cast<std::byte>(x >> (8 * i) & 0xFF);
+    void OBinaryFile::endSection() {
+        if (!inSection_) {
+            return;
         }
-        file.write(data, 4);
-        return file;
+
+        flush();
+        sections_.back().length = tell() - sections_.back().offset;
+        inSection_ = false;
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, int32_t x) {
-        std::byte data[4];
-        for (int i = 3; i >= 0; --i) {
-            data[3-i] = static_cast<std::byte>(x >> (8 * i) & 0xFF);
+    // Write the table of contents after the last section, the buffer is already flushed
+    void OBinaryFile::writeSections() {
+        if (sections_.empty()) {
+            return;
+        }
+
+        endSection();
+        const uint64_t offset = tell();
+
+        // the table is not compressed, the reader finds it from the end of the file
+        std::vector<std::byte> table;
+        for (const auto& section : sections_) {
+            const std::size_t at = table.size();
+            table.resize(at + 24 + section.name.size());
+            storeBigEndian64(table.data() + at, section.name.size());
+            std::memcpy(table.data() + at + 8, section.name.data(), section.name.size());
+            storeBigEndian64(table.data() + at + 8 + section.name.size(), section.offset);
+            storeBigEndian64(table.data() + at + 16 + section.name.size(), section.length);
         }
-        file.write(data, 4);
-        return file;
+
+        std::byte trailer[SectionTrailerSize];
+        storeBigEndian64(trailer, sections_.size());
+        storeBigEndian64(trailer + 8, offset);
+        std::memcpy(trailer + 16, SectionMagic, sizeof(SectionMagic));
+
+        writeToFile(table.data(), table.size());
+        writeToFile(trailer, SectionTrailerSize);
+        flush();
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, uint64_t x) {
-        std::byte data[8];
-        for (int i = 7; i >= 0; --i) {
-            data[7-i] = static_cast<std::byte>(x >> (8 * i) & 0xFF);
+    // The position of the next byte in the file, once the buffer is flushed
+    uint64_t OBinaryFile::tell() const {
+        if (direct_) {
+            return offset_ + static_cast<uint64_t>(pos_ - buffer_.get());
         }
-        file.write(data, 8);
-        return file;
+
+        const off_t offset = ::ftello(file_);
+        if (offset < 0) {
+            throw std::runtime_error("Failed to get the position in file");
+        }
+        return static_cast<uint64_t>(offset);
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, int64_t x) {
-        std::byte data[8];
-        for (int i = 7; i >= 0; --i) {
-            data[7-i] = static_cast<std::byte>(x >> (8 * i) & 0xFF);
+    // Evict what was written since the last time, once there is enough of it
+    void OBinaryFile::dropPages(bool all) {
+        const off_t end = direct_ ? static_cast<off_t>(offset_) : ::ftello(file_);
+        if (end < 0 || static_cast<uint64_t>(end) < dropFrom_ + (all ? 0 : DropWindow)) {
+            return;
         }
-        file.write(data, 8);
-        return file;
+        evictPages(::fileno(file_), dropFrom_, static_cast<uint64_t>(end), true);
+        dropFrom_ = static_cast<uint64_t>(end);
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, char x) {
-        file.write(reinterpret_cast<const std::byte*>(&x), sizeof(x));
-        return file;
+    // Called by write() when the bytes do not fit in the buffer
+    std::size_t OBinaryFile::writeSlow(const std::byte* data, std::size_t size) {
+        if (!file_) {
+            throw std::runtime_error("No file opened");
+        }
+
+        const std::size_t requested = size;
+        for (;;) {
+            // fill the buffer before sending it so that the file only gets full buffers
+            const std::size_t n = std::min<std::size_t>(end_ - pos_, size);
+            if (n > 0) {
+                std::memcpy(pos_, data, n);
+                pos_ += n;
+                data += n;
+                size -= n;
+            }
+
+            if (size == 0) {
+                break;
+            }
+
+            sendBuffer();
+
+            if (!async_ && !direct_ && compression_ == Compression::None && !checksum_ && size >= static_cast<std::size_t>(end_ - pos_)) {
+                // the buffer is empty and too small, large writes go straight to the file
+                writeToFile(data, size);
+                break;
+            }
+        }
+
+        return requested;
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, float x) {
-        file.write(reinterpret_cast<const std::byte*>(&x), sizeof(x));
-        return file;
+    void OBinaryFile::sendBuffer() {
+        if (!buffer_ || pos_ == buffer_.get()) {
+            return;
+        }
+
+        const std::size_t size = pos_ - buffer_.get();
+        const std::size_t capacity = end_ - buffer_.get();
+
+        if (async_) {
+            async_->submit(buffer_, size);
+        } else if (direct_) {
+            // the buffer is full, so its size is a multiple of the alignment
+            if (!writeAt(::fileno(file_), buffer_.get(), size, offset_, SERIAL_STATS_OF(stats_))) {
+                throw std::runtime_error("Failed to write all bytes to file");
+            }
+            offset_ += size;
+        } else if (!writeBlock(file_, compression_, checksum_, block_, buffer_.get(), size, SERIAL_STATS_OF(stats_))) {
+            throw std::runtime_error("Failed to write all bytes to file");
+        }
+
+        pos_ = buffer_.get();
+        end_ = pos_ + capacity;
+
+        if (dropCache_) {
+            dropPages(false);
+        }
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, double x) {
-        file.write(reinterpret_cast<const std::byte*>(&x), sizeof(x));
-        return file;
+    // Write the buffered bytes in whole blocks, padding the last one, which
+    // is then cut by ftruncate(). Its bytes stay in the buffer, and are
+    // written again with the ones that follow.
+    void OBinaryFile::flushDirect() {
+        const std::size_t size = pos_ - buffer_.get();
+        if (size == 0) {
+            return;
+        }
+
+        const std::size_t full = size / DirectAlignment * DirectAlignment;
+        const std::size_t padded = alignUp(size);
+        std::memset(pos_, 0, padded - size);
+
+        const int fd = ::fileno(file_);
+        if (!writeAt(fd, buffer_.get(), padded, offset_, SERIAL_STATS_OF(stats_))
+            || (padded != size && ::ftruncate(fd, static_cast<off_t>(offset_ + size)) != 0)) {
+            throw std::runtime_error("Failed to write all bytes to file");
+        }
+
+        std::memmove(buffer_.get(), buffer_.get() + full, size - full);
+        offset_ += full;
+        pos_ = buffer_.get() + (size - full);
+
+        if (dropCache_) {
+            dropPages(false);
+        }
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, bool x) {
-        file.write(reinterpret_cast<const std::byte*>(&x), sizeof(x));
-        return file;
+    void OBinaryFile::writeToFile(const std::byte* data, std::size_t size) {
+        if (direct_) {
+            // everything goes through the aligned buffer
+            write(data, size);
+            return;
+        }
+
+        const std::size_t written_bytes = SERIAL_IO(&stats_, std::fwrite(data, 1, size, file_));
+        if (written_bytes != size) {
+            throw std::runtime_error("Failed to write all bytes to file");
+        }
     }
 
-    OBinaryFile& operator<<(OBinaryFile &file, const std::string& x) {
-        const std::uint64_t len = x.length();
-        file << len;
-        for (std::uint64_t i = 0; i < len; i++) {
-            file << x[i];
+    void OBinaryFile::writeVarint(uint64_t x) {
+        if (static_cast<std::size_t>(end_ - pos_) >= MaxVarintSize) {
+            const std::size_t size = encodeVarint(pos_, x);
+            pos_ += size;
+#ifdef SERIAL_STATS
+            stats_.bytes += size;
+#endif
+            return;
         }
-        return file;
+
+        std::byte data[MaxVarintSize];
+        write(data, encodeVarint(data, x));
     }
 
     /**
@@ -150,214 +1229,953 @@ namespace serial {
      * error.
      */
     //Constructor
-    IBinaryFile::IBinaryFile(const std::string& filename) {
-        file_ = std::fopen(filename.c_str(), "rb");
+    IBinaryFile::IBinaryFile(const std::string& filename, Mode mode, const Options& options) :
+        file_(nullptr), capacity_(0), pos_(nullptr), end_(nullptr), map_(nullptr), mapSize_(0), mapPos_(nullptr), mode_(mode),
+        encoding_(options.encoding), compression_(options.compression), checksum_(options.checksum), swapsFloats_(false), verify_(options.verify),
+        direct_(mode == Buffered && options.direct), dropCache_(options.dropCache), offset_(0), dropFrom_(0), left_(UINT64_MAX), sectionsLoaded_(false) {
+        if (mode == Mapped) {
+            const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+
+            if (fd < 0)
+                throw std::runtime_error(filename + " could not be opened");
+
+            struct stat st;
+            if (::fstat(fd, &st) != 0) {
+                ::close(fd);
+                throw std::runtime_error(filename + " could not be opened");
+            }
+
+            // an empty file can not be mapped, and does not need to
+            if (st.st_size > 0) {
+                void* map = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+
+                if (map == MAP_FAILED)
+                    throw std::runtime_error(filename + " could not be mapped");
+
+                map_ = map;
+                mapSize_ = static_cast<std::size_t>(st.st_size);
+                mapPos_ = static_cast<const std::byte*>(map_);
+
+                if (options.header) {
+                    try {
+                        decodeHeader(mapPos_, mapSize_, encoding_, compression_, checksum_, swapsFloats_);
+                    } catch (const std::runtime_error&) {
+                        unmap();
+                        throw;
+                    }
+                    mapPos_ += HeaderSize;
+                }
+
+                // the blocks are decoded in a buffer
+                if (!blocks()) {
+                    pos_ = mapPos_;
+                    end_ = static_cast<const std::byte*>(map_) + mapSize_;
+                    mapPos_ = end_;
+                }
+            } else {
+                ::close(fd);
+                if (options.header) {
+                    throw std::runtime_error("Missing file header");
+                }
+            }
+            return;
+        }
+
+        if (direct_) {
+            const int fd = openFile(filename, O_RDONLY | O_CLOEXEC, true);
+            file_ = fd >= 0 ? ::fdopen(fd, "rb") : nullptr;
+            if (fd >= 0 && !file_) {
+                ::close(fd);
+            }
+        } else {
+            file_ = std::fopen(filename.c_str(), "rb");
+        }
 
         if (file_ == nullptr)
             throw std::runtime_error(filename + " could not be opened");
+
+        // the kernel reads further ahead
+        ::posix_fadvise(::fileno(file_), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        // the direct I/O needs an aligned buffer
+        const std::size_t bufferSize = direct_ ? alignUp(options.bufferSize == 0 ? DefaultBufferSize : options.bufferSize) : options.bufferSize;
+        if (bufferSize > 0) {
+            std::setvbuf(file_, nullptr, _IONBF, 0);
+            buffer_ = allocateBuffer(bufferSize);
+            capacity_ = bufferSize;
+        }
+
+        try {
+            if (options.readAhead > 0) {
+                // the chunks are aligned for the direct I/O too
+                const std::size_t chunkSize = alignUp(options.bufferSize == 0 ? DefaultBufferSize : options.bufferSize);
+                ahead_ = std::make_unique<detail::ReadAhead>(::fileno(file_), chunkSize, options.readAhead);
+            }
+
+            if (options.header) {
+                std::byte header[HeaderSize];
+                std::size_t size;
+                if (direct_ && !ahead_) {
+                    refillDirect();
+                    size = std::min<std::size_t>(HeaderSize, end_ - pos_);
+                    std::memcpy(header, pos_, size);
+                    pos_ += size;
+                } else {
+                    size = readFile(header, HeaderSize);
+                }
+                decodeHeader(header, size, encoding_, compression_, checksum_, swapsFloats_);
+            }
+
+            if (direct_ && blocks()) {
+                throw std::runtime_error("Direct I/O does not support compression or checksums");
+            }
+        } catch (const std::runtime_error&) {
+            ahead_.reset();
+            std::fclose(file_);
+            file_ = nullptr;
+            throw;
+        }
     }
 
     //Destructor
     IBinaryFile::~IBinaryFile() {
+        // the reads ahead use the file
+        ahead_.reset();
         if (file_) {
+            if (dropCache_) {
+                ::posix_fadvise(::fileno(file_), 0, 0, POSIX_FADV_DONTNEED);
+            }
             std::fclose(file_);
 
             file_ = nullptr;
         }
+        unmap();
     }
 
     //Move constructor
     IBinaryFile::IBinaryFile(IBinaryFile&& other) noexcept :
-        file_(std::exchange(other.file_, nullptr)){ }
+        file_(std::exchange(other.file_, nullptr)),
+        buffer_(std::move(other.buffer_)),
+        capacity_(std::exchange(other.capacity_, 0)),
+        pos_(std::exchange(other.pos_, nullptr)),
+        end_(std::exchange(other.end_, nullptr)),
+        map_(std::exchange(other.map_, nullptr)),
+        mapSize_(std::exchange(other.mapSize_, 0)),
+        mapPos_(std::exchange(other.mapPos_, nullptr)),
+        mode_(other.mode_),
+        encoding_(other.encoding_),
+        compression_(other.compression_),
+        checksum_(other.checksum_),
+        swapsFloats_(other.swapsFloats_),
+        verify_(other.verify_),
+        direct_(other.direct_),
+        dropCache_(other.dropCache_),
+        offset_(other.offset_),
+        dropFrom_(other.dropFrom_),
+        left_(other.left_),
+        ahead_(std::move(other.ahead_)),
+        block_(std::move(other.block_)),
+        sections_(std::move(other.sections_)),
+        sectionsLoaded_(std::exchange(other.sectionsLoaded_, false))
+#ifdef SERIAL_STATS
+        , stats_(std::exchange(other.stats_, Stats()))
+#endif
+        { }
 
     //Move assignment
     IBinaryFile& IBinaryFile::operator=(IBinaryFile&& other) noexcept {
         if (this != &other) {
+            ahead_.reset();
             if (file_) {
                 fclose(file_);
             }
+            unmap();
             file_ = std::exchange(other.file_, nullptr);
+            buffer_ = std::move(other.buffer_);
+            capacity_ = std::exchange(other.capacity_, 0);
+            pos_ = std::exchange(other.pos_, nullptr);
+            end_ = std::exchange(other.end_, nullptr);
+            map_ = std::exchange(other.map_, nullptr);
+            mapSize_ = std::exchange(other.mapSize_, 0);
+            mapPos_ = std::exchange(other.mapPos_, nullptr);
+            mode_ = other.mode_;
+            encoding_ = other.encoding_;
+            compression_ = other.compression_;
+            checksum_ = other.checksum_;
+            swapsFloats_ = other.swapsFloats_;
+            verify_ = other.verify_;
+            direct_ = other.direct_;
+            dropCache_ = other.dropCache_;
+            offset_ = other.offset_;
+            dropFrom_ = other.dropFrom_;
+            left_ = other.left_;
+            ahead_ = std::move(other.ahead_);
+            block_ = std::move(other.block_);
+            sections_ = std::move(other.sections_);
+            sectionsLoaded_ = std::exchange(other.sectionsLoaded_, false);
+#ifdef SERIAL_STATS
+            stats_ = std::exchange(other.stats_, Stats());
+#endif
         }
         return *this;
     }
 
-    /**
-     * @brief Read `size` bytes from the file and store them in the buffer
-     * pointed by `data`.
-     *
-     * Returns the number of bytes actually read.
-     */
-    std::size_t IBinaryFile::read(std::byte* data, std::size_t size) {
-        auto res = fread(data,sizeof(std::byte),size,file_);
+    void IBinaryFile::unmap() {
+        if (map_) {
+            ::munmap(map_, mapSize_);
+            map_ = nullptr;
+            mapSize_ = 0;
+        }
+    }
 
-        if (res != size) {
-            throw std::runtime_error("Failed to read all bytes from file");
+    // Called by read() when the buffer does not hold enough bytes
+    std::size_t IBinaryFile::readSlow(std::byte* data, std::size_t size) {
+        if (!file_ && mode_ == Buffered) {
+            throw std::runtime_error("No file opened");
         }
 
-        return res;
-    }
+        const std::size_t requested = size;
+        for (;;) {
+            const std::size_t n = std::min<std::size_t>(end_ - pos_, size);
+            if (n > 0) {
+                std::memcpy(data, pos_, n);
+                pos_ += n;
+                data += n;
+                size -= n;
+            }
 
-    IBinaryFile& operator>>(IBinaryFile& file, int8_t& x) {
-        std::byte data;
-        x = 0;
-        file.read(&data,1);
+            if (size == 0) {
+                return requested;
+            }
 
-        x = std::to_integer<int8_t>(data);
+            if (file_ && !blocks() && (!direct_ || ahead_) && size >= capacity_) {
+                // the buffer is empty, large reads go straight to the destination
+                if (readFile(data, size) != size) {
+                    throw std::runtime_error("Failed to read all bytes from file");
+                }
+                return requested;
+            }
 
-        return file;
+            if (!refill()) {
+                throw std::runtime_error("Failed to read all bytes from file");
+            }
+        }
     }
 
-    IBinaryFile& operator>>(IBinaryFile& file, uint8_t& x) {
-        std::byte data;
-        x = 0;
+    // Load the next bytes in the buffer, returns false at the end of the file
+    bool IBinaryFile::refill() {
+        if (!blocks()) {
+            // a mapping is never refilled
+            if (!file_ || capacity_ == 0) {
+                return false;
+            }
+            if (ahead_) {
+                // the chunk is decoded where it was loaded
+                const std::byte* data;
+                const std::size_t size = static_cast<std::size_t>(std::min<uint64_t>(ahead_->next(data), left_));
+                left_ -= size;
+                pos_ = data;
+                end_ = data + size;
+                if (dropCache_) {
+                    dropPages();
+                }
+                return size > 0;
+            }
+            if (direct_) {
+                return refillDirect();
+            }
 
-        file.read(&data,1);
+            const std::size_t res = readFile(buffer_.get(), capacity_);
+            pos_ = buffer_.get();
+            end_ = pos_ + res;
+            if (dropCache_) {
+                dropPages();
+            }
+            return res > 0;
+        }
 
-        x = static_cast<uint8_t>(data);
+        const std::size_t headerSize = detail::BlockHeaderSize + (checksum_ ? detail::ChecksumSize : 0);
+        detail::BlockHeader header;
+        std::byte head[detail::BlockHeaderSize + detail::ChecksumSize];
+        const std::byte* payload;
 
-        return file;
-    }
+        if (mode_ == Mapped) {
+            const auto remaining = static_cast<std::size_t>(std::min<uint64_t>(static_cast<const std::byte*>(map_) + mapSize_ - mapPos_, left_));
+            if (remaining == 0) {
+                return false;
+            }
+            if (remaining < headerSize) {
+                throw std::runtime_error("Truncated block");
+            }
 
-    IBinaryFile& operator>>(IBinaryFile& file, int16_t& x){
-        std::byte data;
-        uint16_t y = 0;
+            std::memcpy(head, mapPos_, headerSize);
+            header = detail::decodeBlockHeader(head, checksum_);
+            mapPos_ += headerSize;
+            if (remaining - headerSize < header.storedSize) {
+                throw std::runtime_error("Truncated block");
+            }
+            payload = mapPos_;
+            mapPos_ += header.storedSize;
+            left_ -= headerSize + header.storedSize;
+        } else {
+            const std::size_t res = readFile(head, headerSize);
+            if (res == 0) {
+                return false;
+            }
+            if (res < headerSize) {
+                throw std::runtime_error("Truncated block");
+            }
 
-        for (int i = 1; i >= 0; i--) {
-            file.read(&data,1);
+            header = detail::decodeBlockHeader(head, checksum_);
+            block_.resize(header.storedSize);
+            if (readFile(block_.data(), header.storedSize) != header.storedSize) {
+                throw std::runtime_error("Truncated block");
+            }
+            payload = block_.data();
+        }
 
-            auto tmp = std::to_integer<uint8_t>(data);
-            y |= static_cast<uint16_t>(tmp) << (8 * i);
+        // the whole block is checked before the codec reads it
+        if (checksum_ && verify_) {
+            detail::verifyBlock(header, head, payload);
         }
 
-        x = static_cast<int16_t>(y);
-        return file;
-    }
+        if (capacity_ < header.rawSize) {
+            buffer_ = allocateBuffer(header.rawSize);
+            capacity_ = header.rawSize;
+        }
 
-    IBinaryFile& operator>>(IBinaryFile& file, uint16_t& x){
-        std::byte data;
-        x = 0;
+        detail::decodeBlock(header, payload, buffer_.get());
+        pos_ = buffer_.get();
+        end_ = pos_ + header.rawSize;
+        if (dropCache_ && file_) {
+            dropPages();
+        }
+        return true;
+    }
 
-        for (int i = 1; i >= 0; i--) {
-            file.read(&data,1);
+    // Read the aligned blocks from the one of the next byte
+    bool IBinaryFile::refillDirect() {
+        const uint64_t aligned = offset_ / DirectAlignment * DirectAlignment;
+        ssize_t res;
+        do {
+            res = SERIAL_IO(&stats_, ::pread(::fileno(file_), buffer_.get(), capacity_, static_cast<off_t>(aligned)));
+        } while (res < 0 && errno == EINTR);
+        if (res < 0) {
+            throw std::runtime_error("Failed to read all bytes from file");
+        }
 
-            auto tmp = std::to_integer<uint8_t>(data);
-            x |= static_cast<uint16_t>(tmp) << (8 * i);
+        const std::byte* data = buffer_.get();
+        end_ = data + res;
+        pos_ = std::min(data + (offset_ - aligned), end_);
+        offset_ = std::max(offset_, aligned + static_cast<uint64_t>(res));
+        if (static_cast<uint64_t>(end_ - pos_) > left_) {
+            end_ = pos_ + left_;
+        }
+        left_ -= end_ - pos_;
+        if (dropCache_) {
+            dropPages();
         }
+        return pos_ < end_;
+    }
 
-        return file;
+    // Read from the file, or from the chunks loaded ahead, up to the end of the section
+    std::size_t IBinaryFile::readFile(std::byte* data, std::size_t size) {
+        size = static_cast<std::size_t>(std::min<uint64_t>(size, left_));
+        const std::size_t res = ahead_ ? ahead_->read(data, size) : SERIAL_IO(&stats_, std::fread(data, 1, size, file_));
+        left_ -= res;
+        return res;
     }
 
-    IBinaryFile& operator>>(IBinaryFile& file, int32_t& x){
-        std::byte data;
-        uint32_t y = 0;
+    // Evict what was read since the last time, once there is enough of it
+    void IBinaryFile::dropPages() {
+        const off_t end = ahead_ ? static_cast<off_t>(ahead_->offset()) : direct_ ? static_cast<off_t>(offset_) : ::ftello(file_);
+        if (end < 0 || static_cast<uint64_t>(end) < dropFrom_ + DropWindow) {
+            return;
+        }
+        evictPages(::fileno(file_), dropFrom_, static_cast<uint64_t>(end), false);
+        dropFrom_ = static_cast<uint64_t>(end);
+    }
 
-        for (int i = 3; i >= 0; i--) {
-            file.read(&data,1);
+    bool IBinaryFile::blocks() const {
+        return compression_ != Compression::None || checksum_;
+    }
 
-            auto tmp = std::to_integer<uint8_t>(data);
-            y |= static_cast<uint32_t>(tmp) << (8 * i);
+    Stats IBinaryFile::stats() const {
+#ifdef SERIAL_STATS
+        Stats stats = stats_;
+        if (ahead_) {
+            const Stats ahead = ahead_->stats();
+            stats.ioCalls += ahead.ioCalls;
+            stats.ioBytes += ahead.ioBytes;
+            stats.blockedNanoseconds += ahead.blockedNanoseconds;
         }
-        x = static_cast<int32_t>(y);
-        return file;
+        return stats;
+#else
+        return Stats();
+#endif
     }
 
-    IBinaryFile& operator>>(IBinaryFile& file, uint32_t& x){
-        std::byte data;
-        x = 0;
+    uint64_t IBinaryFile::fileSize() const {
+        if (mode_ == Mapped) {
+            return mapSize_;
+        }
 
-        for (int i = 3; i >= 0; i--) {
-            file.read(&data,1);
+        struct stat st;
+        if (::fstat(::fileno(file_), &st) != 0) {
+            throw std::runtime_error("Failed to get the size of file");
+        }
+        return static_cast<uint64_t>(st.st_size);
+    }
 
-            auto tmp = std::to_integer<uint8_t>(data);
-            x |= static_cast<uint32_t>(tmp) << (8 * i);
+    // Read at `offset` without moving in the file
+    void IBinaryFile::readAt(uint64_t offset, std::byte* data, std::size_t size) const {
+        if (direct_) {
+            // O_DIRECT reads whole aligned blocks in aligned memory
+            const uint64_t aligned = offset / DirectAlignment * DirectAlignment;
+            const auto skipped = static_cast<std::size_t>(offset - aligned);
+            const std::size_t length = alignUp(skipped + size);
+            detail::Buffer blocks = allocateBuffer(length);
+
+            std::size_t got = 0;
+            while (got < skipped + size) {
+                const ssize_t res = SERIAL_IO(&stats_, ::pread(::fileno(file_), blocks.get() + got, length - got, static_cast<off_t>(aligned + got)));
+                if (res < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (res <= 0) {
+                    throw std::runtime_error("Failed to read all bytes from file");
+                }
+                got += static_cast<std::size_t>(res);
+            }
+            if (size > 0) {
+                std::memcpy(data, blocks.get() + skipped, size);
+            }
+            return;
         }
 
-        return file;
+        if (mode_ == Mapped) {
+            if (offset > mapSize_ || size > mapSize_ - offset) {
+                throw std::runtime_error("Failed to read all bytes from file");
+            }
+            if (size > 0) {
+                std::memcpy(data, static_cast<const std::byte*>(map_) + offset, size);
+            }
+            return;
+        }
+
+        while (size > 0) {
+            const ssize_t res = SERIAL_IO(&stats_, ::pread(::fileno(file_), data, size, static_cast<off_t>(offset)));
+            if (res <= 0) {
+                throw std::runtime_error("Failed to read all bytes from file");
+            }
+            data += res;
+            size -= static_cast<std::size_t>(res);
+            offset += static_cast<uint64_t>(res);
+        }
     }
 
-    IBinaryFile& operator>>(IBinaryFile& file, int64_t& x){
-        std::byte data;
-        uint64_t y = 0;
+    const std::vector<Section>& IBinaryFile::sections() {
+        if (sectionsLoaded_) {
+            return sections_;
+        }
+        if (!file_ && mode_ == Buffered) {
+            throw std::runtime_error("No file opened");
+        }
+
+        const uint64_t size = fileSize();
+        std::vector<Section> sections;
+
+        std::byte trailer[SectionTrailerSize];
+        if (size >= SectionTrailerSize) {
+            readAt(size - SectionTrailerSize, trailer, SectionTrailerSize);
+        }
+
+        if (size >= SectionTrailerSize && std::memcmp(trailer + 16, SectionMagic, sizeof(SectionMagic)) == 0) {
+            const uint64_t count = loadBigEndian64(trailer);
+            const uint64_t tableOffset = loadBigEndian64(trailer + 8);
+            if (tableOffset > size - SectionTrailerSize) {
+                throw std::runtime_error("Corrupted table of contents");
+            }
+
+            std::vector<std::byte> table(size - SectionTrailerSize - tableOffset);
+            readAt(tableOffset, table.data(), table.size());
+
+            std::size_t at = 0;
+            for (uint64_t i = 0; i < count; i++) {
+                if (table.size() - at < 8) {
+                    throw std::runtime_error("Corrupted table of contents");
+                }
+                const uint64_t length = loadBigEndian64(table.data() + at);
+                at += 8;
+                if (table.size() - at < 16 || length > table.size() - at - 16) {
+                    throw std::runtime_error("Corrupted table of contents");
+                }
+
+                Section section;
+                section.name.assign(reinterpret_cast<const char*>(table.data() + at), length);
+                at += length;
+                section.offset = loadBigEndian64(table.data() + at);
+                section.length = loadBigEndian64(table.data() + at + 8);
+                at += 16;
+
+                if (section.offset > tableOffset || section.length > tableOffset - section.offset) {
+                    throw std::runtime_error("Corrupted table of contents");
+                }
+                sections.push_back(std::move(section));
+            }
+        }
 
-        for (int i = 7; i >= 0; i--) {
-            file.read(&data,1);
+        sections_ = std::move(sections);
+        sectionsLoaded_ = true;
+        return sections_;
+    }
 
-            auto tmp = std::to_integer<uint8_t>(data);
-            y |= static_cast<uint64_t>(tmp) << (8 * i);
+    bool IBinaryFile::hasSection(const std::string& name) {
+        for (const auto& section : sections()) {
+            if (section.name == name) {
+                return true;
+            }
         }
-        x = static_cast<int64_t>(y);
-        return file;
+        return false;
     }
 
-    IBinaryFile& operator>>(IBinaryFile& file, uint64_t& x){
-        std::byte data;
-        x = 0;
+    void IBinaryFile::seekSection(const std::string& name) {
+        for (const auto& section : sections()) {
+            if (section.name != name) {
+                continue;
+            }
 
-        for (int i = 7; i >= 0; i--) {
-            file.read(&data,1);
+            // the reads stop at the end of the section
+            left_ = section.length;
+            if (mode_ == Mapped) {
+                const std::byte* base = static_cast<const std::byte*>(map_);
+                if (!blocks()) {
+                    pos_ = base + section.offset;
+                    end_ = pos_ + section.length;
+                } else {
+                    // the section starts with a block
+                    mapPos_ = base + section.offset;
+                    pos_ = nullptr;
+                    end_ = nullptr;
+                }
+                return;
+            }
 
-            auto tmp = std::to_integer<uint8_t>(data);
-            x |= static_cast<uint64_t>(tmp) << (8 * i);
+            if (ahead_) {
+                ahead_->seek(section.offset);
+            } else if (direct_) {
+                offset_ = section.offset;
+            } else if (::fseeko(file_, static_cast<off_t>(section.offset), SEEK_SET) != 0) {
+                throw std::runtime_error("Failed to seek in file");
+            }
+            // drop what the buffer holds
+            pos_ = nullptr;
+            end_ = nullptr;
+            return;
         }
 
-        return file;
+        throw std::runtime_error("Unknown section " + name);
     }
 
-    IBinaryFile& operator>>(IBinaryFile& file, char& x) {
-        std::byte data;
-
-        file.read(&data,1);
+    const std::byte* IBinaryFile::view(std::size_t size) {
+        if (mode_ != Mapped || blocks()) {
+            throw std::runtime_error("Only a mapped file without blocks can be viewed");
+        }
 
-        auto tmp = static_cast<unsigned char>(data);
-        x = static_cast<char>(tmp);
+        if (size > static_cast<std::size_t>(end_ - pos_)) {
+            throw std::runtime_error("Failed to read all bytes from file");
+        }
 
-        return file;
+        const std::byte* data = pos_;
+        pos_ += size;
+#ifdef SERIAL_STATS
+        stats_.bytes += size;
+#endif
+        return data;
     }
 
-    IBinaryFile& operator>>(IBinaryFile& file, float& x) {
-        std::byte data[4];
+    void IBinaryFile::skip(uint64_t size) {
+        const std::size_t n = static_cast<std::size_t>(std::min<uint64_t>(end_ - pos_, size));
+        pos_ += n;
+        size -= n;
+        if (size == 0) {
+            return;
+        }
+
+        if (file_ && !blocks() && size > left_) {
+            throw std::runtime_error("Failed to read all bytes from file");
+        }
 
-        for (int i = 0; i < 4; i++) {
-            file.read(&data[i],1);
+        if (file_ && ahead_ && !blocks()) {
+            const uint64_t offset = ahead_->offset();
+            if (size > fileSize() - offset) {
+                throw std::runtime_error("Failed to read all bytes from file");
+            }
+            ahead_->seek(offset + size);
+            left_ -= size;
+            return;
         }
 
-        std::memcpy(&x,&data,sizeof(float));
+        if (file_ && direct_) {
+            if (size > fileSize() - offset_) {
+                throw std::runtime_error("Failed to read all bytes from file");
+            }
+            offset_ += size;
+            left_ -= size;
+            return;
+        }
 
-        return file;
+        if (file_ && !blocks()) {
+            const off_t offset = ::ftello(file_);
+            if (offset < 0 || size > fileSize() - static_cast<uint64_t>(offset)) {
+                throw std::runtime_error("Failed to read all bytes from file");
+            }
+            if (::fseeko(file_, static_cast<off_t>(size), SEEK_CUR) != 0) {
+                throw std::runtime_error("Failed to seek in file");
+            }
+            left_ -= size;
+            return;
+        }
+
+        // the blocks are decoded to find where the bytes end
+        while (size > 0) {
+            if (!refill()) {
+                throw std::runtime_error("Failed to read all bytes from file");
+            }
+            const std::size_t n = static_cast<std::size_t>(std::min<uint64_t>(end_ - pos_, size));
+            pos_ += n;
+            size -= n;
+        }
     }
 
-    IBinaryFile& operator>>(IBinaryFile& file, double& x) {
-        std::byte data[8];
+    uint64_t IBinaryFile::readVarint() {
+        uint64_t x;
+#ifdef SERIAL_STATS
+        const std::byte* start = pos_;
+#endif
+        if (decodeVarintFast(pos_, end_, x)) {
+#ifdef SERIAL_STATS
+            stats_.bytes += static_cast<uint64_t>(pos_ - start);
+#endif
+            return x;
+        }
 
-        for (int i = 0; i < 8; i++) {
-            file.read(&data[i],1);
+        // near the end of the buffer or longer than 8 bytes
+        x = 0;
+        for (unsigned shift = 0; shift < 7 * MaxVarintSize; shift += 7) {
+            std::byte data;
+            read(&data, 1);
+
+            const auto bits = std::to_integer<uint64_t>(data);
+            x |= (bits & 0x7f) << shift;
+            if ((bits & 0x80) == 0) {
+                return x;
+            }
         }
 
-        std::memcpy(&x,&data,sizeof(double));
+        throw std::runtime_error("Invalid varint");
+    }
 
-        return file;
+    void OBinaryBuffer::grow(std::size_t size) {
+        const std::size_t capacity = std::max({ bytes_.size() * 2, size_ + size, std::size_t(256) });
+        bytes_.resize(capacity);
     }
 
-    IBinaryFile& operator>>(IBinaryFile& file, bool& x) {
-        std::byte data;
+    std::vector<std::byte> OBinaryBuffer::release() {
+        bytes_.resize(size_);
+        std::vector<std::byte> bytes = std::move(bytes_);
+        bytes_.clear();
+        size_ = 0;
+        return bytes;
+    }
 
-        file.read(&data,1);
+    void OBinaryBuffer::writeVarint(uint64_t x) {
+        if (bytes_.size() - size_ < MaxVarintSize) {
+            grow(MaxVarintSize);
+        }
+        size_ += encodeVarint(bytes_.data() + size_, x);
+    }
 
-        x = static_cast<bool>(data);
+    void IBinaryBuffer::throwTruncated() {
+        throw std::runtime_error("Failed to read all bytes from buffer");
+    }
 
-        return file;
+    uint64_t IBinaryBuffer::readVarint() {
+        uint64_t x;
+        if (decodeVarintFast(pos_, end_, x)) {
+            return x;
+        }
+        return decodeVarint(pos_, end_);
     }
 
-    IBinaryFile& operator>>(IBinaryFile& file, std::string& x) {
-        char c;
-        uint64_t size;
-        file >> size;
+    namespace detail {
 
-        for (uint64_t i = 0; i < size; i++) {
-            file >> c;
-            x.push_back(c);
+        void swapFloats(std::byte* data, std::size_t count, std::size_t width) {
+            if (width == sizeof(float)) {
+                byteSwap32(data, data, count);
+            } else {
+                byteSwap64(data, data, count);
+            }
         }
 
-        return file;
-    }
+        template<typename Sink, typename T>
+        void writeBulk(Sink& file, const T* data, std::size_t count) {
+            StatsAccess::primitive(file, primitiveOf<T>(), count);
+
+            // an empty vector may not have any storage
+            if (count == 0) {
+                return;
+            }
+
+            // Floating point values are stored in native order, the other
+            // single byte values as they are in memory
+            if constexpr (std::is_integral_v<T> && sizeof(T) > 1) {
+                if (file.encoding() == Encoding::Compact) {
+                    for (std::size_t i = 0; i < count; i++) {
+                        file.writeVarint(toVarint(data[i]));
+                    }
+                    return;
+                }
+
+                if (detail::swapsBytes(file.encoding())) {
+                    constexpr std::size_t PerChunk = BulkChunkSize / sizeof(T);
+                    std::byte chunk[BulkChunkSize];
+
+                    while (count > 0) {
+                        const std::size_t n = std::min(count, PerChunk);
+                        byteSwapArray<T>(chunk, reinterpret_cast<const std::byte*>(data), n);
+                        file.write(chunk, n * sizeof(T));
+                        data += n;
+                        count -= n;
+                    }
+                    return;
+                }
+            }
+
+            file.write(reinterpret_cast<const std::byte*>(data), count * sizeof(T));
+        }
+
+        template<typename Source, typename T>
+        void readBulk(Source& file, T* data, std::size_t count) {
+            StatsAccess::primitive(file, primitiveOf<T>(), count);
+
+            if (count == 0) {
+                return;
+            }
+
+            if constexpr (std::is_integral_v<T> && sizeof(T) > 1) {
+                if (file.encoding() == Encoding::Compact) {
+                    for (std::size_t i = 0; i < count; i++) {
+                        data[i] = fromVarint<T>(file.readVarint());
+                    }
+                    return;
+                }
+            }
+
+            if constexpr (std::is_same_v<T, bool>) {
+                // Do not store arbitrary bytes in a bool, any non zero byte is true
+                uint8_t chunk[BulkChunkSize];
+
+                while (count > 0) {
+                    const std::size_t n = std::min(count, BulkChunkSize);
+                    file.read(reinterpret_cast<std::byte*>(chunk), n);
+                    for (std::size_t i = 0; i < n; i++) {
+                        data[i] = chunk[i] != 0;
+                    }
+                    data += n;
+                    count -= n;
+                }
+            } else {
+                file.read(reinterpret_cast<std::byte*>(data), count * sizeof(T));
+
+                if constexpr (sizeof(T) > 1 && std::is_integral_v<T>) {
+                    if (detail::swapsBytes(file.encoding())) {
+                        std::byte* bytes = reinterpret_cast<std::byte*>(data);
+                        byteSwapArray<T>(bytes, bytes, count);
+                    }
+                } else if constexpr (std::is_floating_point_v<T>) {
+                    if (file.swapsFloats()) {
+                        swapFloats(reinterpret_cast<std::byte*>(data), count, sizeof(T));
+                    }
+                }
+            }
+        }
+
+        template<typename T>
+        void encodeBulk(Encoding encoding, const T* data, std::size_t count, std::vector<std::byte>& out) {
+            if (count == 0) {
+                return;
+            }
+
+            const std::size_t at = out.size();
+
+            if constexpr (std::is_integral_v<T> && sizeof(T) > 1) {
+                if (encoding == Encoding::Compact) {
+                    out.resize(at + count * MaxVarintSize);
+                    std::byte* p = out.data() + at;
+                    for (std::size_t i = 0; i < count; i++) {
+                        p += encodeVarint(p, toVarint(data[i]));
+                    }
+                    out.resize(p - out.data());
+                    return;
+                }
+
+                if (detail::swapsBytes(encoding)) {
+                    out.resize(at + count * sizeof(T));
+                    byteSwapArray<T>(out.data() + at, reinterpret_cast<const std::byte*>(data), count);
+                    return;
+                }
+            }
+
+            out.resize(at + count * sizeof(T));
+            std::memcpy(out.data() + at, data, count * sizeof(T));
+        }
+
+        template<typename T>
+        std::size_t decodeBulk(Encoding encoding, const std::byte* data, std::size_t size, T* out, std::size_t count) {
+            if constexpr (std::is_integral_v<T> && sizeof(T) > 1) {
+                if (encoding == Encoding::Compact) {
+                    const std::byte* p = data;
+                    for (std::size_t i = 0; i < count; i++) {
+                        out[i] = fromVarint<T>(decodeVarint(p, data + size));
+                    }
+                    return p - data;
+                }
+            }
+
+            if (count > size / sizeof(T)) {
+                throw std::runtime_error("Truncated chunk");
+            }
+            if (count == 0) {
+                return 0;
+            }
+
+            if constexpr (std::is_same_v<T, bool>) {
+                for (std::size_t i = 0; i < count; i++) {
+                    out[i] = data[i] != std::byte{0};
+                }
+            } else if constexpr (sizeof(T) == 1 || std::is_floating_point_v<T>) {
+                std::memcpy(out, data, count * sizeof(T));
+            } else if (detail::swapsBytes(encoding)) {
+                byteSwapArray<T>(reinterpret_cast<std::byte*>(out), data, count);
+            } else {
+                std::memcpy(out, data, count * sizeof(T));
+            }
+            return count * sizeof(T);
+        }
+
+        void parallelFor(std::size_t count, std::size_t threads, const std::function<void(std::size_t)>& fn) {
+            if (threads == 0) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            threads = std::min(threads, count);
+
+            std::atomic<std::size_t> next(0);
+            std::mutex mutex;
+            std::exception_ptr error;
+
+            // each thread takes the next index until there are none left
+            auto work = [&]() {
+                for (;;) {
+                    const std::size_t i = next++;
+                    if (i >= count) {
+                        return;
+                    }
+
+                    try {
+                        fn(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        next = count;
+                        return;
+                    }
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (std::size_t i = 1; i < threads; i++) {
+                workers.emplace_back(work);
+            }
+            work();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        void encodeFloats(FloatCodec codec, const std::byte* data, std::size_t count, std::size_t width, std::vector<std::byte>& out) {
+            std::vector<std::byte> planes(count * width);
+            shuffleBytes(planes.data(), data, count, width, codec == FloatCodec::Xor);
+            encodeBlock(Compression::Lz, planes.data(), planes.size(), out);
+        }
+
+        void decodeFloats(FloatCodec codec, const std::byte* data, std::size_t size, std::byte* out, std::size_t count, std::size_t width) {
+            if (size < BlockHeaderSize) {
+                throw std::runtime_error("Corrupted floats");
+            }
+            const BlockHeader header = decodeBlockHeader(data);
+            if (header.rawSize != count * width || header.storedSize != size - BlockHeaderSize) {
+                throw std::runtime_error("Corrupted floats");
+            }
+
+            std::vector<std::byte> planes(header.rawSize);
+            decodeBlock(header, data + BlockHeaderSize, planes.data());
+            unshuffleBytes(out, planes.data(), count, width, codec == FloatCodec::Xor);
+        }
+
+        template void encodeBulk(Encoding, const uint8_t*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const int8_t*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const uint16_t*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const int16_t*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const uint32_t*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const int32_t*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const uint64_t*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const int64_t*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const char*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const float*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const double*, std::size_t, std::vector<std::byte>&);
+        template void encodeBulk(Encoding, const bool*, std::size_t, std::vector<std::byte>&);
+
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, uint8_t*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, int8_t*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, uint16_t*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, int16_t*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, uint32_t*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, int32_t*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, uint64_t*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, int64_t*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, char*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, float*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, double*, std::size_t);
+        template std::size_t decodeBulk(Encoding, const std::byte*, std::size_t, bool*, std::size_t);
+
+#define SERIAL_INSTANTIATE_BULK(T) \
+        template void writeBulk(OBinaryFile&, const T*, std::size_t); \
+        template void writeBulk(OBinaryBuffer&, const T*, std::size_t); \
+        template void readBulk(IBinaryFile&, T*, std::size_t); \
+        template void readBulk(IBinaryBuffer&, T*, std::size_t);
+
+        SERIAL_INSTANTIATE_BULK(uint8_t)
+        SERIAL_INSTANTIATE_BULK(int8_t)
+        SERIAL_INSTANTIATE_BULK(uint16_t)
+        SERIAL_INSTANTIATE_BULK(int16_t)
+        SERIAL_INSTANTIATE_BULK(uint32_t)
+        SERIAL_INSTANTIATE_BULK(int32_t)
+        SERIAL_INSTANTIATE_BULK(uint64_t)
+        SERIAL_INSTANTIATE_BULK(int64_t)
+        SERIAL_INSTANTIATE_BULK(char)
+        SERIAL_INSTANTIATE_BULK(float)
+        SERIAL_INSTANTIATE_BULK(double)
+        SERIAL_INSTANTIATE_BULK(bool)
+
+#undef SERIAL_INSTANTIATE_BULK
+
+    } // namespace detail
 }
@@ -4,15 +4,253 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 
+#include <algorithm>
 #include <array>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <set>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "BitPack.h"
+
+/**
+ * @brief Declare the fields of a struct to serialize, in order
+ *
+ * Put `SERIAL_FIELDS(a, b, c)` in the body of the struct, then `operator<<`
+ * and `operator>>` write and read the listed fields one after the other. The
+ * macro defines the `serialFields()` member functions.
+ */
+#define SERIAL_FIELDS(...) \
+  auto serialFields() { return std::tie(__VA_ARGS__); } \
+  auto serialFields() const { return std::tie(__VA_ARGS__); }
+
 namespace serial {
 
+  /**
+   * @brief The default capacity of the buffer of a file
+   */
+  constexpr std::size_t DefaultBufferSize = 64 * 1024;
+
+  /**
+   * @brief The encoding of integers and sizes
+   */
+  enum class Encoding {
+    Fixed,        ///< big-endian with the full width of the type
+    Compact,      ///< LEB128 varints, zigzag encoded for signed types
+    LittleEndian, ///< little-endian with the full width of the type
+    Native = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__ ? Fixed : LittleEndian, ///< the byte order of the host, nothing is swapped
+  };
+
+  /**
+   * @brief The codec used to compress the blocks of a file
+   */
+  enum class Compression {
+    None, ///< the bytes are written as they are
+    Lz,   ///< built-in LZ codec, always available
+    Lz4,  ///< lz4, if it was found when configuring the build
+    Zstd, ///< zstd, if it was found when configuring the build
+  };
+
+  /**
+   * @brief The settings of a file
+   *
+   * A file must be read with the same encoding it was written with.
+   */
+  struct Options {
+    /**
+     * @brief Capacity of the buffer, 0 disables it
+     */
+    std::size_t bufferSize = DefaultBufferSize;
+
+    /**
+     * @brief Encoding of the integers and of the sizes of the containers
+     *
+     * In every encoding, single byte values, `float` and `double` are
+     * stored as they are in memory.
+     */
+    Encoding encoding = Encoding::Fixed;
+
+    /**
+     * @brief Start the file with a header, and expect one when reading
+     *
+     * The header holds a magic number, the version of the format, the byte
+     * order of the writer, the encoding and the compression. A reader takes
+     * the encoding and the compression from the header instead of these
+     * options, and throws a `std::runtime_error` if the header is missing or
+     * of a later version. The integers are read the same whatever the byte
+     * order of the writer, and the reader of a file from a host of the other
+     * byte order swaps the bytes of its `float` and `double` values. Without
+     * a header, they are read in the byte order of the host. Appending to a
+     * file that is not empty does not write a header again.
+     */
+    bool header = false;
+
+    /**
+     * @brief Write the buffers from a background thread
+     *
+     * Only used by `OBinaryFile`. The bytes are serialized in one buffer while
+     * the thread writes the previous one, and the serialization waits when
+     * both are full. An error of the thread is thrown by the next call that
+     * hands it a buffer, by `flush()` or by `close()`, and again by every
+     * later one, since the bytes of that buffer are lost.
+     */
+    bool async = false;
+
+    /**
+     * @brief Compress the file in blocks of `bufferSize` bytes
+     *
+     * Each block is preceded by a small header and is stored uncompressed if
+     * the codec does not make it smaller. A reader only needs a value other
+     * than `None` to decode the blocks, whatever codec they use. A compressed
+     * mapped file can not give views on its content.
+     */
+    Compression compression = Compression::None;
+
+    /**
+     * @brief Follow the header of each block with the CRC32C of the block
+     *
+     * The file is written in the blocks of the compression, even without a
+     * codec, and a reader checks each block before decoding it. A reader
+     * must use the same value unless it reads a header, and a mapped file
+     * with checksums can not give views on its content.
+     */
+    bool checksum = false;
+
+    /**
+     * @brief Check the CRC of each block of a file with checksums
+     *
+     * Only used by `IBinaryFile`. Trusted files can skip the check.
+     */
+    bool verify = true;
+
+    /**
+     * @brief Bypass the page cache with `O_DIRECT`
+     *
+     * The file is written and read with `pwrite()` and `pread()` of whole
+     * aligned blocks from aligned buffers, whose size is rounded up to 4 KiB.
+     * Only for uncompressed files without checksums, and not with `async`.
+     * A mapped file ignores it, and the file is opened without `O_DIRECT`
+     * if the file system does not support it.
+     */
+    bool direct = false;
+
+    /**
+     * @brief Evict the pages of the file from the page cache as it is
+     * written or read
+     *
+     * Keeps a large file from pushing the working set of the process out of
+     * the cache. The pages are written back and evicted every 64 MiB, and
+     * when the file is closed.
+     */
+    bool dropCache = false;
+
+    /**
+     * @brief Reserve this many bytes on the disk when opening the file
+     *
+     * Only used by `OBinaryFile`, with `fallocate()` on Linux, and ignored
+     * if the file system does not support it. The size of the file does not
+     * change.
+     */
+    uint64_t preallocate = 0;
+
+    /**
+     * @brief Load up to this many buffers ahead of the one being decoded
+     *
+     * Only used by a `Buffered` `IBinaryFile`. The reads are in flight
+     * together through io_uring when the library is built with liburing and
+     * the kernel allows it, or are made one after the other by a background
+     * thread otherwise. With 0, the file is read when the buffer is empty.
+     */
+    std::size_t readAhead = 0;
+  };
+
+  /**
+   * @brief A named section of a file
+   *
+   * The offset and the length are in bytes of the file as stored on disk.
+   */
+  struct Section {
+    std::string name;
+    uint64_t offset;
+    uint64_t length;
+  };
+
+  /**
+   * @brief The kinds of values counted by `Stats`
+   */
+  enum class Primitive {
+    UInt8,
+    Int8,
+    UInt16,
+    Int16,
+    UInt32,
+    Int32,
+    UInt64,
+    Int64,
+    Char,
+    Float,
+    Double,
+    Bool,
+    String,
+    Count, ///< the number of kinds
+  };
+
+  /**
+   * @brief What a file did since it was opened
+   *
+   * The counters are only maintained when the library is built with
+   * `SERIAL_STATS` defined (the `SERIAL_STATS` CMake option), they stay at 0
+   * otherwise and cost nothing. Everything that includes this header must
+   * agree on `SERIAL_STATS`.
+   */
+  struct Stats {
+    uint64_t bytes = 0;              ///< encoded bytes written or read, before compression
+    uint64_t ioBytes = 0;            ///< bytes written to or read from the system
+    uint64_t ioCalls = 0;            ///< calls to the system to write, read or flush
+    uint64_t flushes = 0;            ///< flushes of the buffer
+    uint64_t blockedNanoseconds = 0; ///< time spent waiting for the system or for the writer thread
+    uint64_t primitives[static_cast<std::size_t>(Primitive::Count)] = {}; ///< values of each kind, in containers too, the sizes are `UInt64`
+    uint64_t containers = 0;         ///< vectors, arrays, maps and sets
+    uint64_t elements = 0;           ///< elements of these containers
+
+    uint64_t primitive(Primitive kind) const {
+      return primitives[static_cast<std::size_t>(kind)];
+    }
+  };
+
+  namespace detail {
+    class AsyncWriter;
+    class ReadAhead;
+    struct StatsAccess;
+
+    /**
+     * @brief Frees a buffer allocated with the alignment of the direct I/O
+     */
+    struct AlignedDelete {
+      void operator()(std::byte* data) const;
+    };
+
+    /**
+     * @brief The buffer of a file
+     */
+    using Buffer = std::unique_ptr<std::byte[], AlignedDelete>;
+  }
+
   /**
    * @brief A file to be written
    */
@@ -30,16 +268,80 @@ namespace serial {
      * @brief Constructor
      *
      * Opens the file for writing or throws a `std::runtime_error` in case of
-     * error.
+     * error. The written bytes are kept in a buffer of `options.bufferSize`
+     * bytes and only reach the file when it is full, when `flush()` is called
+     * or when the file is closed.
      */
-    OBinaryFile(const std::string& filename, Mode mode = Truncate);
+    OBinaryFile(const std::string& filename, Mode mode = Truncate, const Options& options = Options());
 
     /**
      * @brief Write `size` bytes pointed by `data` in the file
      *
      * Returns the number of bytes actually written
      */
-    std::size_t write(const std::byte* data, std::size_t size);
+    std::size_t write(const std::byte* data, std::size_t size) {
+#ifdef SERIAL_STATS
+      stats_.bytes += size;
+#endif
+      if (size <= static_cast<std::size_t>(end_ - pos_)) {
+        std::memcpy(pos_, data, size);
+        pos_ += size;
+        return size;
+      }
+      return writeSlow(data, size);
+    }
+
+    /**
+     * @brief Write the buffered bytes in the file
+     *
+     * Throws a `std::runtime_error` in case of error.
+     */
+    void flush();
+
+    /**
+     * @brief Flush and close the file
+     *
+     * Writes the table of contents of the sections, if any. Throws a
+     * `std::runtime_error` if some bytes could not be written. The destructor
+     * closes the file too but can not report errors. Does nothing if the file
+     * is already closed.
+     */
+    void close();
+
+    /**
+     * @brief Start a section named `name`, ending the current one if any
+     *
+     * The offset and the length of each section are recorded in a table of
+     * contents written at the end of the file by `close()`, so a reader can
+     * jump to a section with `IBinaryFile::seekSection()`. The buffer is
+     * flushed so that the section starts on its own block. Throws a
+     * `std::runtime_error` if a section already has this name.
+     */
+    void beginSection(const std::string& name);
+
+    /**
+     * @brief End the current section
+     *
+     * Does nothing if no section is open.
+     */
+    void endSection();
+
+    /**
+     * @brief Write `x` as a LEB128 varint
+     */
+    void writeVarint(uint64_t x);
+
+    /**
+     * @brief The encoding of the integers in the file
+     */
+    Encoding encoding() const {
+      return encoding_;
+    }
+
+    /**
+     * @brief A snapshot of the counters of the file
+     */
+    Stats stats() const;
 
     /**
      *
@@ -49,6 +351,8 @@ namespace serial {
 
     /**
      * @brief Destructor
+     *
+     * Closes the file, ignoring errors.
      */
     ~OBinaryFile();
 
@@ -78,7 +382,34 @@ namespace serial {
     OBinaryFile& operator=(OBinaryFile&& other) noexcept;
 
   private:
+    std::size_t writeSlow(const std::byte* data, std::size_t size);
+    void sendBuffer();
+    void flushDirect();
+    void writeSections();
+    void writeToFile(const std::byte* data, std::size_t size);
+    uint64_t tell() const;
+    void dropPages(bool all);
+
     FILE* file_;
+    detail::Buffer buffer_;
+    std::byte* pos_;
+    std::byte* end_;
+    Encoding encoding_;
+    Compression compression_;
+    bool checksum_;
+    bool direct_;
+    bool dropCache_;
+    uint64_t offset_;
+    uint64_t dropFrom_;
+    std::vector<std::byte> block_;
+    std::unique_ptr<detail::AsyncWriter> async_;
+    std::vector<Section> sections_;
+    bool inSection_;
+#ifdef SERIAL_STATS
+    Stats stats_;
+#endif
+
+    friend struct detail::StatsAccess;
   };
 
   /**
@@ -86,13 +417,23 @@ namespace serial {
    */
   class IBinaryFile {
   public:
+    /**
+     * @brief The way the file is accessed
+     */
+    enum Mode {
+      Buffered, ///< read in chunks through a buffer
+      Mapped,   ///< mapped read-only in memory
+    };
+
     /**
      * @brief Constructor
      *
      * Opens the file for reading or throws a `std::runtime_error` in case of
-     * error.
+     * error. A `Buffered` file reads `options.bufferSize` bytes at a time, a
+     * `Mapped` file is decoded straight from the mapping and can give views on
+     * its content with `view()`.
      */
-    IBinaryFile(const std::string& filename);
+    IBinaryFile(const std::string& filename, Mode mode = Buffered, const Options& options = Options());
 
     /**
     * @brief Destructor
@@ -133,125 +474,2407 @@ namespace serial {
      *
      * Returns the number of bytes actually read.
      */
-    std::size_t read(std::byte* data, std::size_t size);
+    std::size_t read(std::byte* data, std::size_t size) {
+#ifdef SERIAL_STATS
+      stats_.bytes += size;
+#endif
+      if (size <= static_cast<std::size_t>(end_ - pos_)) {
+        std::memcpy(data, pos_, size);
+        pos_ += size;
+        return size;
+      }
+      return readSlow(data, size);
+    }
+
+    /**
+     * @brief Consume the next `size` bytes of the file without copying them
+     *
+     * Returns a pointer in the mapping that stays valid as long as the file is
+     * open. Throws a `std::runtime_error` if the file is not `Mapped`, if it
+     * is compressed or if there are not enough bytes left.
+     */
+    const std::byte* view(std::size_t size);
+
+    /**
+     * @brief Consume the next `size` bytes of the file without decoding them
+     *
+     * Seeks in an uncompressed file. Throws a `std::runtime_error` if there
+     * are not enough bytes left.
+     */
+    void skip(uint64_t size);
+
+    /**
+     * @brief Read a LEB128 varint
+     *
+     * Throws a `std::runtime_error` if the varint is longer than 10 bytes.
+     */
+    uint64_t readVarint();
+
+    /**
+     * @brief The encoding of the integers in the file
+     */
+    Encoding encoding() const {
+      return encoding_;
+    }
+
+    /**
+     * @brief The codec of the blocks of the file
+     */
+    Compression compression() const {
+      return compression_;
+    }
+
+    /**
+     * @brief Tells if the blocks of the file have checksums
+     */
+    bool checksum() const {
+      return checksum_;
+    }
+
+    /**
+     * @brief Tells if the header of the file says it was written by a host
+     * of the other byte order, whose `float` and `double` values are swapped
+     * when they are read
+     */
+    bool swapsFloats() const {
+      return swapsFloats_;
+    }
+
+    /**
+     * @brief The sections of the file
+     *
+     * The table of contents is read at the first call, without moving in the
+     * file. Returns an empty list if the file has no sections.
+     */
+    const std::vector<Section>& sections();
+
+    /**
+     * @brief Tells if the file has a section named `name`
+     */
+    bool hasSection(const std::string& name);
+
+    /**
+     * @brief Move to the start of the section named `name`
+     *
+     * Throws a `std::runtime_error` if there is no such section.
+     */
+    void seekSection(const std::string& name);
+
+    /**
+     * @brief A snapshot of the counters of the file
+     */
+    Stats stats() const;
+
+    /**
+     * @brief Tells if the file is mapped in memory
+     */
+    bool mapped() const {
+      return mode_ == Mapped;
+    }
 
   private:
+    std::size_t readSlow(std::byte* data, std::size_t size);
+    bool refill();
+    bool refillDirect();
+    std::size_t readFile(std::byte* data, std::size_t size);
+    bool blocks() const;
+    void unmap();
+    uint64_t fileSize() const;
+    void readAt(uint64_t offset, std::byte* data, std::size_t size) const;
+    void dropPages();
+
     FILE *file_;
+    detail::Buffer buffer_;
+    std::size_t capacity_;
+    const std::byte* pos_;
+    const std::byte* end_;
+    void* map_;
+    std::size_t mapSize_;
+    const std::byte* mapPos_;
+    Mode mode_;
+    Encoding encoding_;
+    Compression compression_;
+    bool checksum_;
+    bool swapsFloats_;
+    bool verify_;
+    bool direct_;
+    bool dropCache_;
+    uint64_t offset_;
+    uint64_t dropFrom_;
+    uint64_t left_;
+    std::unique_ptr<detail::ReadAhead> ahead_;
+    std::vector<std::byte> block_;
+    std::vector<Section> sections_;
+    bool sectionsLoaded_;
+#ifdef SERIAL_STATS
+    mutable Stats stats_;
+#endif
+
+    friend struct detail::StatsAccess;
   };
 
+  /**
+   * @brief A growable buffer in memory, written like an `OBinaryFile`
+   */
+  class OBinaryBuffer {
+  public:
+    /**
+     * @brief Constructor
+     *
+     * Only `options.encoding` is used.
+     */
+    explicit OBinaryBuffer(const Options& options = Options()) : size_(0), encoding_(options.encoding) { }
+
+    /**
+     * @brief Append `size` bytes pointed by `data` to the buffer
+     *
+     * Returns the number of bytes written.
+     */
+    std::size_t write(const std::byte* data, std::size_t size) {
+      if (size > bytes_.size() - size_) {
+        grow(size);
+      }
+      if (size > 0) {
+        std::memcpy(bytes_.data() + size_, data, size);
+        size_ += size;
+      }
+      return size;
+    }
 
-  OBinaryFile& operator<<(OBinaryFile& file, uint8_t x);
-  OBinaryFile& operator<<(OBinaryFile& file, int8_t x);
-  OBinaryFile& operator<<(OBinaryFile& file, uint16_t x);
-  OBinaryFile& operator<<(OBinaryFile& file, int16_t x);
-  OBinaryFile& operator<<(OBinaryFile& file, uint32_t x);
-  OBinaryFile& operator<<(OBinaryFile& file, int32_t x);
-  OBinaryFile& operator<<(OBinaryFile& file, uint64_t x);
-  OBinaryFile& operator<<(OBinaryFile& file, int64_t x);
-  OBinaryFile& operator<<(OBinaryFile& file, char x);
-  OBinaryFile& operator<<(OBinaryFile& file, float x);
-  OBinaryFile& operator<<(OBinaryFile& file, double x);
-  OBinaryFile& operator<<(OBinaryFile& file, bool x);
-  OBinaryFile& operator<<(OBinaryFile& file, const std::string& x);
+    /**
+     * @brief Write `x` as a LEB128 varint
+     */
+    void writeVarint(uint64_t x);
 
-  template<typename T>
-  OBinaryFile& operator<<(OBinaryFile& file, const std::vector<T>& x) {
-    const auto size = static_cast<uint64_t>(x.size());
-    file << size;
-    for (const auto& elem : x) {
-      file << elem;
+    /**
+     * @brief The encoding of the integers in the buffer
+     */
+    Encoding encoding() const {
+      return encoding_;
     }
-    return file;
-  }
 
-  template<typename T, std::size_t N>
-  OBinaryFile& operator<<(OBinaryFile& file, const std::array<T,N>& x) {
-    for (uint64_t i = 0; i < N; i++) {
-      file << x[i];
+    /**
+     * @brief The bytes written so far
+     */
+    const std::byte* data() const {
+      return bytes_.data();
     }
-    return file;
-  }
 
-  template<typename K, typename V>
-  OBinaryFile& operator<<(OBinaryFile& file, const std::map<K,V>& x) {
-    const auto size = static_cast<uint64_t>(x.size());
-    file << size;
-    for (const auto& [key, value] : x) {
-      file << key << value;
+    std::size_t size() const {
+      return size_;
     }
-    return file;
-  }
 
-  template<typename T>
-  OBinaryFile& operator<<(OBinaryFile& file, const std::set<T>& x) {
-    const auto size = static_cast<uint64_t>(x.size());
-    file << size;
-    for (const auto& elem : x) {
-      file << elem;
+    /**
+     * @brief Forget the bytes written, keeping the memory
+     */
+    void clear() {
+      size_ = 0;
     }
-    return file;
-  }
 
-  IBinaryFile& operator>>(IBinaryFile& file, int8_t& x);
-  IBinaryFile& operator>>(IBinaryFile& file, uint8_t& x);
-  IBinaryFile& operator>>(IBinaryFile& file, int16_t& x);
-  IBinaryFile& operator>>(IBinaryFile& file, uint16_t& x);
-  IBinaryFile& operator>>(IBinaryFile& file, int32_t& x);
-  IBinaryFile& operator>>(IBinaryFile& file, uint32_t& x);
-  IBinaryFile& operator>>(IBinaryFile& file, int64_t& x);
-  IBinaryFile& operator>>(IBinaryFile& file, uint64_t& x);
-  IBinaryFile& operator>>(IBinaryFile& file, char& x);
-  IBinaryFile& operator>>(IBinaryFile& file, float& x);
-  IBinaryFile& operator>>(IBinaryFile& file, double& x);
-  IBinaryFile& operator>>(IBinaryFile& file, bool& x);
-  IBinaryFile& operator>>(IBinaryFile& file, std::string& x);
+    /**
+     * @brief Give the bytes written and empty the buffer
+     */
+    std::vector<std::byte> release();
 
-  template<typename T>
-  IBinaryFile& operator>>(IBinaryFile& file, std::vector<T>& x) {
-    T value;
-    uint64_t size;
-    file >> size;
+  private:
+    void grow(std::size_t size);
 
-    for (uint64_t i = 0; i < size; i++) {
-      file >> value;
-      x.push_back(value);
+    std::vector<std::byte> bytes_;
+    std::size_t size_;
+    Encoding encoding_;
+  };
+
+  /**
+   * @brief A sequence of bytes in memory, read like an `IBinaryFile`
+   *
+   * The bytes are not copied and must outlive the buffer.
+   */
+  class IBinaryBuffer {
+  public:
+    /**
+     * @brief Constructor
+     *
+     * Only `options.encoding` is used. With `swapsFloats`, the bytes come
+     * from a host of the other byte order and the bytes of the `float` and
+     * `double` values are swapped when they are read.
+     */
+    IBinaryBuffer(const std::byte* data, std::size_t size, const Options& options = Options(), bool swapsFloats = false) :
+      pos_(data), end_(data + size), encoding_(options.encoding), swapsFloats_(swapsFloats) { }
+
+    /**
+     * @brief Read `size` bytes from the buffer and store them in the buffer
+     * pointed by `data`
+     *
+     * Throws a `std::runtime_error` if there are not enough bytes left.
+     */
+    std::size_t read(std::byte* data, std::size_t size) {
+      if (size > static_cast<std::size_t>(end_ - pos_)) {
+        throwTruncated();
+      }
+      if (size > 0) {
+        std::memcpy(data, pos_, size);
+        pos_ += size;
+      }
+      return size;
     }
 
-    return file;
-  }
+    /**
+     * @brief Consume the next `size` bytes without copying them
+     *
+     * Throws a `std::runtime_error` if there are not enough bytes left.
+     */
+    const std::byte* view(std::size_t size) {
+      if (size > static_cast<std::size_t>(end_ - pos_)) {
+        throwTruncated();
+      }
+      const std::byte* data = pos_;
+      pos_ += size;
+      return data;
+    }
 
-  template<typename T, std::size_t N>
-  IBinaryFile& operator>>(IBinaryFile& file, std::array<T, N>& x) {
-    T value;
-    for (uint64_t i = 0; i < N; i++) {
-      file >> value;
-      x[i] = value;
+    /**
+     * @brief Consume the next `size` bytes without decoding them
+     */
+    void skip(uint64_t size) {
+      view(static_cast<std::size_t>(std::min<uint64_t>(size, SIZE_MAX)));
     }
-    return file;
-  }
 
-  template<typename K, typename V>
-  IBinaryFile& operator>>(IBinaryFile& file, std::map<K, V>& x) {
-    uint64_t size; file >> size;
-    K key;
-    V value;
+    /**
+     * @brief Read a LEB128 varint
+     */
+    uint64_t readVarint();
 
-    for (uint64_t i = 0; i < size; i++) {
-      file >> key >> value;
-      x.insert({key,value});
+    /**
+     * @brief The encoding of the integers in the buffer
+     */
+    Encoding encoding() const {
+      return encoding_;
     }
-    return file;
-  }
 
-  template<typename T>
-  IBinaryFile& operator>>(IBinaryFile& file, std::set<T>& x) {
-    uint64_t size; file >> size;
-    T value;
-    for (uint64_t i = 0; i < size; i++) {
-      file >> value;
-      x.insert(value);
+    /**
+     * @brief Tells if the bytes of the `float` and `double` values are
+     * swapped when they are read
+     */
+    bool swapsFloats() const {
+      return swapsFloats_;
     }
-    return file;
+
+    /**
+     * @brief The number of bytes left
+     */
+    std::size_t remaining() const {
+      return end_ - pos_;
+    }
+
+  private:
+    [[noreturn]] static void throwTruncated();
+
+    const std::byte* pos_;
+    const std::byte* end_;
+    Encoding encoding_;
+    bool swapsFloats_;
+  };
+
+  namespace detail {
+
+    /**
+     * @brief Tells if the operators can write to a `Sink`
+     */
+    template<typename Sink>
+    struct is_sink : std::false_type {};
+
+    template<> struct is_sink<OBinaryFile> : std::true_type {};
+    template<> struct is_sink<OBinaryBuffer> : std::true_type {};
+
+    template<typename Sink>
+    inline constexpr bool is_sink_v = is_sink<Sink>::value;
+
+    /**
+     * @brief Tells if the operators can read from a `Source`
+     */
+    template<typename Source>
+    struct is_source : std::false_type {};
+
+    template<> struct is_source<IBinaryFile> : std::true_type {};
+    template<> struct is_source<IBinaryBuffer> : std::true_type {};
+
+    template<typename Source>
+    inline constexpr bool is_source_v = is_source<Source>::value;
+
+    // The return type of the operators, which only exist for the sinks and the sources
+    template<typename Sink>
+    using sink_t = std::enable_if_t<is_sink_v<Sink>, Sink&>;
+
+    template<typename Source>
+    using source_t = std::enable_if_t<is_source_v<Source>, Source&>;
+
+    /**
+     * @brief Tells if `view()` can be called on the source
+     */
+    inline bool viewable(const IBinaryFile& file) {
+      return file.mapped() && file.compression() == Compression::None && !file.checksum();
+    }
+
+    inline bool viewable(const IBinaryBuffer&) {
+      return true;
+    }
+
+    template<typename T>
+    constexpr Primitive primitiveOf() {
+      if constexpr (std::is_same_v<T, uint8_t>) return Primitive::UInt8;
+      else if constexpr (std::is_same_v<T, int8_t>) return Primitive::Int8;
+      else if constexpr (std::is_same_v<T, uint16_t>) return Primitive::UInt16;
+      else if constexpr (std::is_same_v<T, int16_t>) return Primitive::Int16;
+      else if constexpr (std::is_same_v<T, uint32_t>) return Primitive::UInt32;
+      else if constexpr (std::is_same_v<T, int32_t>) return Primitive::Int32;
+      else if constexpr (std::is_same_v<T, uint64_t>) return Primitive::UInt64;
+      else if constexpr (std::is_same_v<T, int64_t>) return Primitive::Int64;
+      else if constexpr (std::is_same_v<T, char>) return Primitive::Char;
+      else if constexpr (std::is_same_v<T, float>) return Primitive::Float;
+      else if constexpr (std::is_same_v<T, double>) return Primitive::Double;
+      else if constexpr (std::is_same_v<T, bool>) return Primitive::Bool;
+      else return Primitive::String;
+    }
+
+    /**
+     * @brief Updates the counters of the files, does nothing for the
+     * buffers or without `SERIAL_STATS`
+     */
+    struct StatsAccess {
+      template<typename Stream>
+      static void primitive([[maybe_unused]] Stream& stream, [[maybe_unused]] Primitive kind, [[maybe_unused]] uint64_t count = 1) {
+#ifdef SERIAL_STATS
+        if constexpr (std::is_same_v<Stream, OBinaryFile> || std::is_same_v<Stream, IBinaryFile>) {
+          stream.stats_.primitives[static_cast<std::size_t>(kind)] += count;
+        }
+#endif
+      }
+
+      template<typename Stream>
+      static void container([[maybe_unused]] Stream& stream, [[maybe_unused]] uint64_t elements) {
+#ifdef SERIAL_STATS
+        if constexpr (std::is_same_v<Stream, OBinaryFile> || std::is_same_v<Stream, IBinaryFile>) {
+          stream.stats_.containers++;
+          stream.stats_.elements += elements;
+        }
+#endif
+      }
+    };
+
+    /**
+     * @brief Make a `T` that allocates with `alloc` if it is allocator-aware,
+     * so the elements read in a container use the memory of the container
+     */
+    template<typename T, typename Alloc>
+    T makeElement(const Alloc& alloc) {
+      if constexpr (!std::uses_allocator_v<T, Alloc>) {
+        return T();
+      } else if constexpr (std::is_constructible_v<T, std::allocator_arg_t, const Alloc&>) {
+        return T(std::allocator_arg, alloc);
+      } else {
+        return T(alloc);
+      }
+    }
+
+    inline uint64_t zigzagEncode(int64_t x) {
+      return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63);
+    }
+
+    inline int64_t zigzagDecode(uint64_t x) {
+      return static_cast<int64_t>((x >> 1) ^ (~(x & 1) + 1));
+    }
+
+    template<typename T>
+    uint64_t toVarint(T x) {
+      if constexpr (std::is_signed_v<T>) {
+        return zigzagEncode(x);
+      } else {
+        return x;
+      }
+    }
+
+    /**
+     * @brief Convert a varint back to a `T`
+     *
+     * Throws a `std::runtime_error` if it does not fit.
+     */
+    template<typename T>
+    T fromVarint(uint64_t x) {
+      if constexpr (std::is_signed_v<T>) {
+        const int64_t y = zigzagDecode(x);
+        if (y < std::numeric_limits<T>::min() || y > std::numeric_limits<T>::max()) {
+          throw std::runtime_error("Integer out of range");
+        }
+        return static_cast<T>(y);
+      } else {
+        if (x > std::numeric_limits<T>::max()) {
+          throw std::runtime_error("Integer out of range");
+        }
+        return static_cast<T>(x);
+      }
+    }
+
+    // Integers of more than one byte are in the byte order of the
+    // encoding, or varints with the compact encoding
+    template<typename T, typename Sink>
+    void writeInteger(Sink& file, T x) {
+      const Encoding encoding = file.encoding();
+      if (encoding == Encoding::Compact) {
+        file.writeVarint(toVarint(x));
+        return;
+      }
+      if (encoding == Encoding::Native) {
+        file.write(reinterpret_cast<const std::byte*>(&x), sizeof(T));
+        return;
+      }
+
+      using U = std::make_unsigned_t<T>;
+      const bool big = encoding == Encoding::Fixed;
+      std::byte data[sizeof(T)];
+      for (std::size_t i = 0; i < sizeof(T); i++) {
+        data[big ? sizeof(T) - 1 - i : i] = static_cast<std::byte>(static_cast<U>(x) >> (8 * i) & 0xFF);
+      }
+      file.write(data, sizeof(T));
+    }
+
+    template<typename T, typename Source>
+    T readInteger(Source& file) {
+      const Encoding encoding = file.encoding();
+      if (encoding == Encoding::Compact) {
+        return fromVarint<T>(file.readVarint());
+      }
+
+      T x;
+      if (encoding == Encoding::Native) {
+        file.read(reinterpret_cast<std::byte*>(&x), sizeof(T));
+        return x;
+      }
+
+      using U = std::make_unsigned_t<T>;
+      const bool big = encoding == Encoding::Fixed;
+      std::byte data[sizeof(T)];
+      file.read(data, sizeof(T));
+      U u = 0;
+      for (std::size_t i = 0; i < sizeof(T); i++) {
+        u = static_cast<U>(u | std::to_integer<U>(data[big ? sizeof(T) - 1 - i : i]) << (8 * i));
+      }
+      return static_cast<T>(u);
+    }
+
+    // Single byte and floating point values are written as they are in memory
+    template<typename T, typename Sink>
+    void writeRaw(Sink& file, T x) {
+      file.write(reinterpret_cast<const std::byte*>(&x), sizeof(T));
+    }
+
+    /**
+     * @brief Reverse the bytes of the `count` values of `width` bytes, 4 or
+     * 8, pointed by `data`
+     */
+    void swapFloats(std::byte* data, std::size_t count, std::size_t width);
+
+    template<typename T, typename Source>
+    T readRaw(Source& file) {
+      T x;
+      file.read(reinterpret_cast<std::byte*>(&x), sizeof(T));
+      if constexpr (std::is_floating_point_v<T>) {
+        if (file.swapsFloats()) {
+          swapFloats(reinterpret_cast<std::byte*>(&x), 1, sizeof(T));
+        }
+      }
+      return x;
+    }
+
+  } // namespace detail
+
+  /**
+   * @brief A read-only view on a sequence of single byte values
+   */
+  template<typename T>
+  class Span {
+    static_assert(sizeof(T) == 1 && !std::is_same_v<T, bool>, "only single byte values can be viewed in place");
+
+  public:
+    Span() : data_(nullptr), size_(0) { }
+    Span(const T* data, std::size_t size) : data_(data), size_(size) { }
+
+    const T* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    const T& operator[](std::size_t i) const { return data_[i]; }
+
+  private:
+    const T* data_;
+    std::size_t size_;
+  };
+
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, uint8_t x) {
+    detail::StatsAccess::primitive(file, Primitive::UInt8);
+    detail::writeRaw(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, int8_t x) {
+    detail::StatsAccess::primitive(file, Primitive::Int8);
+    detail::writeRaw(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, uint16_t x) {
+    detail::StatsAccess::primitive(file, Primitive::UInt16);
+    detail::writeInteger(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, int16_t x) {
+    detail::StatsAccess::primitive(file, Primitive::Int16);
+    detail::writeInteger(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, uint32_t x) {
+    detail::StatsAccess::primitive(file, Primitive::UInt32);
+    detail::writeInteger(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, int32_t x) {
+    detail::StatsAccess::primitive(file, Primitive::Int32);
+    detail::writeInteger(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, uint64_t x) {
+    detail::StatsAccess::primitive(file, Primitive::UInt64);
+    detail::writeInteger(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, int64_t x) {
+    detail::StatsAccess::primitive(file, Primitive::Int64);
+    detail::writeInteger(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, char x) {
+    detail::StatsAccess::primitive(file, Primitive::Char);
+    detail::writeRaw(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, float x) {
+    detail::StatsAccess::primitive(file, Primitive::Float);
+    detail::writeRaw(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, double x) {
+    detail::StatsAccess::primitive(file, Primitive::Double);
+    detail::writeRaw(file, x);
+    return file;
+  }
+
+  template<typename Sink>
+  detail::sink_t<Sink> operator<<(Sink& file, bool x) {
+    detail::StatsAccess::primitive(file, Primitive::Bool);
+    detail::writeRaw(file, static_cast<uint8_t>(x));
+    return file;
+  }
+
+  template<typename Sink, typename Traits, typename Alloc>
+  detail::sink_t<Sink> operator<<(Sink& file, const std::basic_string<char, Traits, Alloc>& x) {
+    detail::StatsAccess::primitive(file, Primitive::String);
+    file << static_cast<uint64_t>(x.size());
+    file.write(reinterpret_cast<const std::byte*>(x.data()), x.size());
+    return file;
+  }
+
+  namespace detail {
+
+    /**
+     * @brief Tells if `T` is a primitive type whose sequences can be encoded
+     * in one pass
+     */
+    template<typename T>
+    struct is_bulk : std::false_type {};
+
+    template<> struct is_bulk<uint8_t> : std::true_type {};
+    template<> struct is_bulk<int8_t> : std::true_type {};
+    template<> struct is_bulk<uint16_t> : std::true_type {};
+    template<> struct is_bulk<int16_t> : std::true_type {};
+    template<> struct is_bulk<uint32_t> : std::true_type {};
+    template<> struct is_bulk<int32_t> : std::true_type {};
+    template<> struct is_bulk<uint64_t> : std::true_type {};
+    template<> struct is_bulk<int64_t> : std::true_type {};
+    template<> struct is_bulk<char> : std::true_type {};
+    template<> struct is_bulk<float> : std::true_type {};
+    template<> struct is_bulk<double> : std::true_type {};
+    template<> struct is_bulk<bool> : std::true_type {};
+
+    template<typename T>
+    inline constexpr bool is_bulk_v = is_bulk<T>::value;
+
+    constexpr bool HostIsBigEndian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+
+    /**
+     * @brief Tells if `T` declares its fields with `SERIAL_FIELDS`
+     */
+    template<typename T, typename = void>
+    struct is_reflected : std::false_type {};
+
+    template<typename T>
+    struct is_reflected<T, std::void_t<decltype(std::declval<const T&>().serialFields())>> : std::true_type {};
+
+    template<typename T>
+    inline constexpr bool is_reflected_v = is_reflected<T>::value;
+
+    /**
+     * @brief Tells if the fixed encoding of `T` is its bytes in memory
+     *
+     * Single byte values and floating point values are written as they are,
+     * the other integers only on a big-endian host. A reflected struct is raw
+     * if its fields are, and if they fill it without padding.
+     */
+    template<typename T, typename = void>
+    struct is_raw : std::bool_constant<is_bulk_v<T> && !std::is_same_v<T, bool>
+      && (sizeof(T) == 1 || std::is_floating_point_v<T> || HostIsBigEndian)> {};
+
+    template<typename T, std::size_t N>
+    struct is_raw<std::array<T, N>> : is_raw<T> {};
+
+    template<typename Tuple>
+    struct raw_fields;
+
+    template<typename... F>
+    struct raw_fields<std::tuple<F...>> {
+      static constexpr bool value = (is_raw<std::remove_cv_t<std::remove_reference_t<F>>>::value && ...);
+      static constexpr std::size_t size = (sizeof(std::remove_reference_t<F>) + ... + 0);
+    };
+
+    template<typename T>
+    struct is_raw<T, std::enable_if_t<is_reflected_v<T>>> : std::bool_constant<std::is_trivially_copyable_v<T>
+      && raw_fields<decltype(std::declval<const T&>().serialFields())>::value
+      && raw_fields<decltype(std::declval<const T&>().serialFields())>::size == sizeof(T)> {};
+
+    template<typename T>
+    inline constexpr bool is_raw_v = is_raw<T>::value;
+
+    /**
+     * @brief Tells if the `Native` encoding of `T` is its bytes in memory
+     *
+     * Same as `is_raw` with the integers of any width.
+     */
+    template<typename T, typename = void>
+    struct is_native : std::bool_constant<is_bulk_v<T> && !std::is_same_v<T, bool>> {};
+
+    template<typename T, std::size_t N>
+    struct is_native<std::array<T, N>> : is_native<T> {};
+
+    template<typename Tuple>
+    struct native_fields;
+
+    template<typename... F>
+    struct native_fields<std::tuple<F...>> {
+      static constexpr bool value = (is_native<std::remove_cv_t<std::remove_reference_t<F>>>::value && ...);
+    };
+
+    template<typename T>
+    struct is_native<T, std::enable_if_t<is_reflected_v<T>>> : std::bool_constant<std::is_trivially_copyable_v<T>
+      && native_fields<decltype(std::declval<const T&>().serialFields())>::value
+      && raw_fields<decltype(std::declval<const T&>().serialFields())>::size == sizeof(T)> {};
+
+    template<typename T>
+    inline constexpr bool is_native_v = is_native<T>::value;
+
+    /**
+     * @brief Tells if the integers of more than one byte are swapped between
+     * the memory and a file with this encoding
+     */
+    inline bool swapsBytes(Encoding encoding) {
+      return encoding == (HostIsBigEndian ? Encoding::LittleEndian : Encoding::Fixed);
+    }
+
+    /**
+     * @brief Tells if the fields of `x` are listed in the order of the memory,
+     * which the types alone can not tell
+     */
+    template<typename T>
+    bool inMemoryOrder(const T& x) {
+      if constexpr (is_reflected_v<T>) {
+        const auto* base = reinterpret_cast<const std::byte*>(&x);
+        std::size_t offset = 0;
+        bool ok = true;
+        std::apply([&](const auto&... fields) {
+          ((ok = ok && reinterpret_cast<const std::byte*>(&fields) - base == static_cast<std::ptrdiff_t>(offset)
+            && inMemoryOrder(fields), offset += sizeof(fields)), ...);
+        }, x.serialFields());
+        return ok;
+      } else if constexpr (is_native_v<T> && !is_bulk_v<T>) {
+        // a std::array
+        return x.empty() || inMemoryOrder(x[0]);
+      } else {
+        return true;
+      }
+    }
+
+    /**
+     * @brief Tells if values like `x` can be copied as they are to and from
+     * a file with this encoding
+     */
+    template<typename T>
+    bool isRawCopy(Encoding encoding, const T& x) {
+      if constexpr (is_raw_v<T>) {
+        return (!HostIsBigEndian || encoding == Encoding::Native) && inMemoryOrder(x);
+      } else if constexpr (is_native_v<T>) {
+        return encoding == Encoding::Native && inMemoryOrder(x);
+      } else {
+        return false;
+      }
+    }
+
+    /**
+     * @brief Tells if values like `x` can be copied as they are from the
+     * source, which is not the case when its floating point values are
+     * swapped
+     */
+    template<typename Source, typename T>
+    bool isRawRead(const Source& file, const T& x) {
+      return !file.swapsFloats() && isRawCopy(file.encoding(), x);
+    }
+
+    /**
+     * @brief Write `count` values pointed by `data` in the file
+     *
+     * The bytes are the same as writing each value with `operator<<`, but
+     * they are encoded in one pass and handed to the file in large writes.
+     */
+    template<typename Sink, typename T>
+    void writeBulk(Sink& file, const T* data, std::size_t count);
+
+    /**
+     * @brief Read `count` values from the file and store them in the buffer
+     * pointed by `data`
+     *
+     * The counterpart of `writeBulk()`.
+     */
+    template<typename Source, typename T>
+    void readBulk(Source& file, T* data, std::size_t count);
+
+  } // namespace detail
+
+  template<typename Sink, typename T, typename Alloc>
+  detail::sink_t<Sink> operator<<(Sink& file, const std::vector<T, Alloc>& x) {
+    const auto size = static_cast<uint64_t>(x.size());
+    detail::StatsAccess::container(file, size);
+    file << size;
+    if constexpr (detail::is_bulk_v<T> && !std::is_same_v<T, bool>) {
+      detail::writeBulk(file, x.data(), x.size());
+    } else if (!x.empty() && detail::isRawCopy(file.encoding(), x[0])) {
+      file.write(reinterpret_cast<const std::byte*>(x.data()), x.size() * sizeof(T));
+    } else {
+      for (const auto& elem : x) {
+        file << elem;
+      }
+    }
+    return file;
+  }
+
+  template<typename Sink, typename T, std::size_t N>
+  detail::sink_t<Sink> operator<<(Sink& file, const std::array<T,N>& x) {
+    detail::StatsAccess::container(file, N);
+    if constexpr (detail::is_bulk_v<T>) {
+      detail::writeBulk(file, x.data(), N);
+    } else if (N > 0 && detail::isRawCopy(file.encoding(), x[0])) {
+      file.write(reinterpret_cast<const std::byte*>(x.data()), N * sizeof(T));
+    } else {
+      for (uint64_t i = 0; i < N; i++) {
+        file << x[i];
+      }
+    }
+    return file;
+  }
+
+  template<typename Sink, typename K, typename V, typename Compare, typename Alloc>
+  detail::sink_t<Sink> operator<<(Sink& file, const std::map<K, V, Compare, Alloc>& x) {
+    const auto size = static_cast<uint64_t>(x.size());
+    detail::StatsAccess::container(file, size);
+    file << size;
+    for (const auto& [key, value] : x) {
+      file << key << value;
+    }
+    return file;
+  }
+
+  template<typename Sink, typename T, typename Compare, typename Alloc>
+  detail::sink_t<Sink> operator<<(Sink& file, const std::set<T, Compare, Alloc>& x) {
+    const auto size = static_cast<uint64_t>(x.size());
+    detail::StatsAccess::container(file, size);
+    file << size;
+    for (const auto& elem : x) {
+      file << elem;
+    }
+    return file;
+  }
+
+  namespace detail {
+
+    /**
+     * @brief Tells if the associative container holds keys only
+     */
+    template<typename Table>
+    constexpr bool is_key_table_v = std::is_same_v<typename Table::key_type, typename Table::value_type>;
+
+    /**
+     * @brief Write the elements of a `std::unordered_map` or a
+     * `std::unordered_set`, like the ones of a `std::map` or a `std::set`
+     */
+    template<typename Sink, typename Table>
+    void writeTable(Sink& file, const Table& x) {
+      for (const auto& elem : x) {
+        if constexpr (is_key_table_v<Table>) {
+          file << elem;
+        } else {
+          file << elem.first << elem.second;
+        }
+      }
+    }
+
+    /**
+     * @brief Read `size` elements in a `std::unordered_map` or a
+     * `std::unordered_set`
+     *
+     * The buckets are allocated first, at least `bucketCount` of them, so
+     * the insertions never rehash.
+     */
+    template<typename Source, typename Table>
+    void readTable(Source& file, Table& x, uint64_t size, uint64_t bucketCount) {
+      x.clear();
+      x.reserve(static_cast<std::size_t>(size));
+      if (bucketCount > x.bucket_count()) {
+        x.rehash(static_cast<std::size_t>(bucketCount));
+      }
+
+      for (uint64_t i = 0; i < size; i++) {
+        if constexpr (is_key_table_v<Table>) {
+          auto value = makeElement<typename Table::value_type>(x.get_allocator());
+          file >> value;
+          x.emplace(std::move(value));
+        } else {
+          auto key = makeElement<typename Table::key_type>(x.get_allocator());
+          auto value = makeElement<typename Table::mapped_type>(x.get_allocator());
+          file >> key >> value;
+          x.emplace(std::move(key), std::move(value));
+        }
+      }
+    }
+
+  } // namespace detail
+
+  /**
+   * @brief Write a `std::unordered_map` like a `std::map`, with its
+   * elements in the order of the table
+   */
+  template<typename Sink, typename K, typename V, typename Hash, typename KeyEqual, typename Alloc>
+  detail::sink_t<Sink> operator<<(Sink& file, const std::unordered_map<K, V, Hash, KeyEqual, Alloc>& x) {
+    const auto size = static_cast<uint64_t>(x.size());
+    detail::StatsAccess::container(file, size);
+    file << size;
+    detail::writeTable(file, x);
+    return file;
+  }
+
+  /**
+   * @brief Write a `std::unordered_set` like a `std::set`, with its
+   * elements in the order of the table
+   */
+  template<typename Sink, typename T, typename Hash, typename KeyEqual, typename Alloc>
+  detail::sink_t<Sink> operator<<(Sink& file, const std::unordered_set<T, Hash, KeyEqual, Alloc>& x) {
+    const auto size = static_cast<uint64_t>(x.size());
+    detail::StatsAccess::container(file, size);
+    file << size;
+    detail::writeTable(file, x);
+    return file;
+  }
+
+  /**
+   * @brief Write the fields of a struct declared with `SERIAL_FIELDS`
+   */
+  template<typename Sink, typename T, typename = std::enable_if_t<detail::is_reflected_v<T>>>
+  detail::sink_t<Sink> operator<<(Sink& file, const T& x) {
+    if (detail::isRawCopy(file.encoding(), x)) {
+      file.write(reinterpret_cast<const std::byte*>(&x), sizeof(T));
+      return file;
+    }
+
+    std::apply([&file](const auto&... fields) {
+      (file << ... << fields);
+    }, x.serialFields());
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, int8_t& x) {
+    detail::StatsAccess::primitive(file, Primitive::Int8);
+    x = detail::readRaw<int8_t>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, uint8_t& x) {
+    detail::StatsAccess::primitive(file, Primitive::UInt8);
+    x = detail::readRaw<uint8_t>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, int16_t& x) {
+    detail::StatsAccess::primitive(file, Primitive::Int16);
+    x = detail::readInteger<int16_t>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, uint16_t& x) {
+    detail::StatsAccess::primitive(file, Primitive::UInt16);
+    x = detail::readInteger<uint16_t>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, int32_t& x) {
+    detail::StatsAccess::primitive(file, Primitive::Int32);
+    x = detail::readInteger<int32_t>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, uint32_t& x) {
+    detail::StatsAccess::primitive(file, Primitive::UInt32);
+    x = detail::readInteger<uint32_t>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, int64_t& x) {
+    detail::StatsAccess::primitive(file, Primitive::Int64);
+    x = detail::readInteger<int64_t>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, uint64_t& x) {
+    detail::StatsAccess::primitive(file, Primitive::UInt64);
+    x = detail::readInteger<uint64_t>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, char& x) {
+    detail::StatsAccess::primitive(file, Primitive::Char);
+    x = detail::readRaw<char>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, float& x) {
+    detail::StatsAccess::primitive(file, Primitive::Float);
+    x = detail::readRaw<float>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, double& x) {
+    detail::StatsAccess::primitive(file, Primitive::Double);
+    x = detail::readRaw<double>(file);
+    return file;
+  }
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, bool& x) {
+    detail::StatsAccess::primitive(file, Primitive::Bool);
+    // any non zero byte is true
+    x = detail::readRaw<uint8_t>(file) != 0;
+    return file;
+  }
+
+  template<typename Source, typename Traits, typename Alloc>
+  detail::source_t<Source> operator>>(Source& file, std::basic_string<char, Traits, Alloc>& x) {
+    detail::StatsAccess::primitive(file, Primitive::String);
+    uint64_t size;
+    file >> size;
+    x.resize(static_cast<std::size_t>(size));
+    file.read(reinterpret_cast<std::byte*>(x.data()), x.size());
+    return file;
+  }
+
+  /**
+   * @brief Read a serialized `std::string` from a mapped file or a buffer
+   * without copying it
+   *
+   * The view stays valid as long as the file is open.
+   */
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, std::string_view& x) {
+    detail::StatsAccess::primitive(file, Primitive::String);
+    uint64_t size;
+    file >> size;
+    const std::byte* data = file.view(static_cast<std::size_t>(size));
+    x = std::string_view(reinterpret_cast<const char*>(data), static_cast<std::size_t>(size));
+    return file;
+  }
+
+  /**
+   * @brief Read a serialized `std::vector` of single byte values from a mapped
+   * file without copying it
+   *
+   * The view stays valid as long as the file is open.
+   */
+  template<typename Source, typename T>
+  detail::source_t<Source> operator>>(Source& file, Span<T>& x) {
+    uint64_t size;
+    file >> size;
+    const std::byte* data = file.view(static_cast<std::size_t>(size));
+    x = Span<T>(reinterpret_cast<const T*>(data), static_cast<std::size_t>(size));
+    return file;
+  }
+
+  template<typename Source, typename T, typename Alloc>
+  detail::source_t<Source> operator>>(Source& file, std::vector<T, Alloc>& x) {
+    uint64_t size;
+    file >> size;
+    detail::StatsAccess::container(file, size);
+
+    if constexpr (detail::is_bulk_v<T> && !std::is_same_v<T, bool>) {
+      x.resize(static_cast<std::size_t>(size));
+      detail::readBulk(file, x.data(), x.size());
+    } else if constexpr (detail::is_reflected_v<T>) {
+      // the records are read in place
+      x.resize(static_cast<std::size_t>(size));
+      if (!x.empty() && detail::isRawRead(file, x[0])) {
+        file.read(reinterpret_cast<std::byte*>(x.data()), x.size() * sizeof(T));
+      } else {
+        for (auto& elem : x) {
+          file >> elem;
+        }
+      }
+    } else if constexpr (std::is_same_v<T, bool>) {
+      bool value;
+      x.clear();
+      for (uint64_t i = 0; i < size; i++) {
+        file >> value;
+        x.push_back(value);
+      }
+    } else {
+      // the elements are built by the allocator of the vector, then read in place
+      x.clear();
+      x.resize(static_cast<std::size_t>(size));
+      for (auto& elem : x) {
+        file >> elem;
+      }
+    }
+
+    return file;
+  }
+
+  template<typename Source, typename T, std::size_t N>
+  detail::source_t<Source> operator>>(Source& file, std::array<T, N>& x) {
+    detail::StatsAccess::container(file, N);
+    if constexpr (detail::is_bulk_v<T>) {
+      detail::readBulk(file, x.data(), N);
+    } else if (N > 0 && detail::isRawRead(file, x[0])) {
+      file.read(reinterpret_cast<std::byte*>(x.data()), N * sizeof(T));
+    } else {
+      T value;
+      for (uint64_t i = 0; i < N; i++) {
+        file >> value;
+        x[i] = value;
+      }
+    }
+    return file;
+  }
+
+  /**
+   * @brief Read the fields of a struct declared with `SERIAL_FIELDS`
+   */
+  template<typename Source, typename T, typename = std::enable_if_t<detail::is_reflected_v<T>>>
+  detail::source_t<Source> operator>>(Source& file, T& x) {
+    if (detail::isRawRead(file, x)) {
+      file.read(reinterpret_cast<std::byte*>(&x), sizeof(T));
+      return file;
+    }
+
+    std::apply([&file](auto&... fields) {
+      (file >> ... >> fields);
+    }, x.serialFields());
+    return file;
+  }
+
+  /**
+   * @brief A vector of structs declared with `SERIAL_FIELDS`, encoded by
+   * columns
+   *
+   * The values of each field are written one after the other, for all the
+   * records, after the length of the column in bytes. The reader can load a
+   * subset of the columns and skips the others at once: the records keep
+   * the value of the fields that are not loaded. The columns are numbered
+   * in the order of `SERIAL_FIELDS`. Use `columnar()` to build it.
+   */
+  template<typename Vector>
+  class Columnar {
+  public:
+    using value_type = typename std::remove_const_t<Vector>::value_type;
+
+    static_assert(detail::is_reflected_v<value_type>, "the records must declare their fields with SERIAL_FIELDS");
+
+    /**
+     * @brief The number of fields of the records
+     */
+    static constexpr std::size_t ColumnCount = std::tuple_size_v<decltype(std::declval<const value_type&>().serialFields())>;
+
+    static_assert(ColumnCount <= 64, "at most 64 columns");
+
+    Columnar(Vector& records, uint64_t columns) : records_(records), columns_(columns) { }
+
+    Vector& records() const {
+      return records_;
+    }
+
+    /**
+     * @brief Tells if the column is written or loaded
+     */
+    bool selected(std::size_t column) const {
+      return (columns_ >> column & 1) != 0;
+    }
+
+  private:
+    Vector& records_;
+    uint64_t columns_;
+  };
+
+  /**
+   * @brief Encode or decode every column of `records`
+   */
+  template<typename Vector>
+  Columnar<Vector> columnar(Vector& records) {
+    return Columnar<Vector>(records, ~uint64_t(0));
+  }
+
+  /**
+   * @brief Decode the given columns of `records`
+   *
+   * Throws a `std::out_of_range` if a column is not one of the records.
+   */
+  template<typename Vector>
+  Columnar<Vector> columnar(Vector& records, std::initializer_list<std::size_t> columns) {
+    uint64_t mask = 0;
+    for (std::size_t column : columns) {
+      if (column >= Columnar<Vector>::ColumnCount) {
+        throw std::out_of_range("Column " + std::to_string(column) + " out of range");
+      }
+      mask |= uint64_t(1) << column;
+    }
+    return Columnar<Vector>(records, mask);
+  }
+
+  namespace detail {
+
+    // Number of values of a column gathered in a chunk for writeBulk()/readBulk()
+    constexpr std::size_t ColumnChunkSize = 4096;
+
+    template<typename T, std::size_t I>
+    using field_t = std::remove_cv_t<std::remove_reference_t<std::tuple_element_t<I, decltype(std::declval<T&>().serialFields())>>>;
+
+    /**
+     * @brief The size of each value of type `T` in a file with this
+     * encoding, or 0 if it varies
+     */
+    template<typename T>
+    std::size_t fixedSize(Encoding encoding) {
+      if constexpr (is_bulk_v<T>) {
+        return (sizeof(T) == 1 || std::is_floating_point_v<T> || encoding != Encoding::Compact) ? sizeof(T) : 0;
+      } else if constexpr (is_native_v<T>) {
+        // the fields fill the struct, and each one keeps its width
+        return encoding != Encoding::Compact ? sizeof(T) : 0;
+      } else {
+        return 0;
+      }
+    }
+
+    template<std::size_t I, typename Sink, typename T>
+    void writeColumn(Sink& file, const std::vector<T>& records) {
+      using F = field_t<T, I>;
+      if constexpr (is_bulk_v<F>) {
+        const std::size_t capacity = std::min(records.size(), ColumnChunkSize);
+        auto chunk = std::make_unique<F[]>(capacity);
+        for (std::size_t i = 0; i < records.size(); i += capacity) {
+          const std::size_t count = std::min(capacity, records.size() - i);
+          for (std::size_t j = 0; j < count; j++) {
+            chunk[j] = std::get<I>(records[i + j].serialFields());
+          }
+          writeBulk(file, chunk.get(), count);
+        }
+      } else {
+        for (const auto& record : records) {
+          file << std::get<I>(record.serialFields());
+        }
+      }
+    }
+
+    template<std::size_t I, typename Source, typename T>
+    void readColumn(Source& file, std::vector<T>& records) {
+      using F = field_t<T, I>;
+      if constexpr (is_bulk_v<F>) {
+        const std::size_t capacity = std::min(records.size(), ColumnChunkSize);
+        auto chunk = std::make_unique<F[]>(capacity);
+        for (std::size_t i = 0; i < records.size(); i += capacity) {
+          const std::size_t count = std::min(capacity, records.size() - i);
+          readBulk(file, chunk.get(), count);
+          for (std::size_t j = 0; j < count; j++) {
+            std::get<I>(records[i + j].serialFields()) = chunk[j];
+          }
+        }
+      } else {
+        for (auto& record : records) {
+          file >> std::get<I>(record.serialFields());
+        }
+      }
+    }
+
+    // Each column is preceded by its length in bytes. The columns whose
+    // values have a fixed size are written in place, the others are
+    // encoded in memory first to know their length
+    template<std::size_t I, typename Sink, typename T>
+    void writeSizedColumn(Sink& file, const std::vector<T>& records) {
+      const std::size_t size = fixedSize<field_t<T, I>>(file.encoding());
+      if (size > 0) {
+        file << static_cast<uint64_t>(records.size()) * size;
+        writeColumn<I>(file, records);
+        return;
+      }
+
+      Options options;
+      options.encoding = file.encoding();
+      OBinaryBuffer buffer(options);
+      writeColumn<I>(buffer, records);
+      file << static_cast<uint64_t>(buffer.size());
+      file.write(buffer.data(), buffer.size());
+    }
+
+    // The columns that are not selected are skipped at once
+    template<std::size_t I, typename Source, typename Vector>
+    void readSizedColumn(Source& file, const Columnar<Vector>& x) {
+      uint64_t length;
+      file >> length;
+      if (x.selected(I)) {
+        readColumn<I>(file, x.records());
+      } else {
+        file.skip(length);
+      }
+    }
+
+    template<typename Sink, typename Vector, std::size_t... I>
+    void writeColumns(Sink& file, const Columnar<Vector>& x, std::index_sequence<I...>) {
+      (writeSizedColumn<I>(file, x.records()), ...);
+    }
+
+    template<typename Source, typename Vector, std::size_t... I>
+    void readColumns(Source& file, const Columnar<Vector>& x, std::index_sequence<I...>) {
+      (readSizedColumn<I>(file, x), ...);
+    }
+
+  } // namespace detail
+
+  /**
+   * @brief Write every column of the records
+   */
+  template<typename Sink, typename Vector>
+  detail::sink_t<Sink> operator<<(Sink& file, const Columnar<Vector>& x) {
+    file << static_cast<uint64_t>(x.records().size()) << static_cast<uint64_t>(Columnar<Vector>::ColumnCount);
+    detail::writeColumns(file, x, std::make_index_sequence<Columnar<Vector>::ColumnCount>());
+    return file;
+  }
+
+  /**
+   * @brief Read the selected columns of the records
+   *
+   * Throws a `std::runtime_error` if the records were written with another
+   * number of fields.
+   */
+  template<typename Source, typename T>
+  detail::source_t<Source> operator>>(Source& file, const Columnar<std::vector<T>>& x) {
+    uint64_t size, columns;
+    file >> size >> columns;
+    if (columns != Columnar<std::vector<T>>::ColumnCount) {
+      throw std::runtime_error("Column count mismatch");
+    }
+
+    x.records().resize(static_cast<std::size_t>(size));
+    detail::readColumns(file, x, std::make_index_sequence<Columnar<std::vector<T>>::ColumnCount>());
+    return file;
+  }
+
+  /**
+   * @brief How a container is split to be encoded and decoded concurrently
+   */
+  struct Parallelism {
+    std::size_t threads = 0;        ///< number of threads, 0 for one per core
+    std::size_t chunkSize = 1 << 16; ///< number of elements of each chunk
+  };
+
+  /**
+   * @brief A large `std::vector`, `std::string` or `std::map`, encoded and
+   * decoded by chunks on several threads
+   *
+   * The chunks are encoded concurrently in memory, then written in order
+   * after a table of their sizes. The reader loads the chunks, straight from
+   * the mapping if the file is mapped, and decodes them concurrently in the
+   * container, which is allocated first. The chunk size is stored, so the
+   * reader may use other settings. Use `parallel()` to build it.
+   */
+  template<typename Container>
+  class Parallel {
+  public:
+    Parallel(Container& value, const Parallelism& parallelism) : value_(value), parallelism_(parallelism) { }
+
+    Container& value() const {
+      return value_;
+    }
+
+    const Parallelism& parallelism() const {
+      return parallelism_;
+    }
+
+  private:
+    Container& value_;
+    Parallelism parallelism_;
+  };
+
+  template<typename Container>
+  Parallel<Container> parallel(Container& value, const Parallelism& parallelism = Parallelism()) {
+    return Parallel<Container>(value, parallelism);
+  }
+
+  namespace detail {
+
+    /**
+     * @brief Encode `count` values pointed by `data` at the end of `out`
+     *
+     * The bytes are the same as `writeBulk()` with this encoding.
+     */
+    template<typename T>
+    void encodeBulk(Encoding encoding, const T* data, std::size_t count, std::vector<std::byte>& out);
+
+    /**
+     * @brief Decode `count` values from the `size` bytes pointed by `data`
+     *
+     * Returns the number of bytes used. Throws a `std::runtime_error` if
+     * `data` is too short.
+     */
+    template<typename T>
+    std::size_t decodeBulk(Encoding encoding, const std::byte* data, std::size_t size, T* out, std::size_t count);
+
+    /**
+     * @brief Call `fn(i)` for each `i` in `[0, count)` on up to `threads`
+     * threads, 0 for one per core
+     *
+     * The first exception thrown by `fn` is rethrown once the threads are done.
+     */
+    void parallelFor(std::size_t count, std::size_t threads, const std::function<void(std::size_t)>& fn);
+
+    /**
+     * @brief Encode `count` chunks concurrently with `encode(i, out)`, then
+     * write them after the table of their sizes
+     */
+    template<typename Sink, typename Encode>
+    void writeChunks(Sink& file, std::size_t count, std::size_t threads, Encode encode) {
+      std::vector<std::vector<std::byte>> chunks(count);
+      parallelFor(count, threads, [&](std::size_t i) {
+        encode(i, chunks[i]);
+      });
+
+      file << static_cast<uint64_t>(count);
+      for (const auto& chunk : chunks) {
+        file << static_cast<uint64_t>(chunk.size());
+      }
+      for (const auto& chunk : chunks) {
+        file.write(chunk.data(), chunk.size());
+      }
+    }
+
+    /**
+     * @brief Read the chunks written by `writeChunks()` and decode them
+     * concurrently with `decode(i, data, size)`
+     *
+     * Throws a `std::runtime_error` if the source does not hold `count` chunks.
+     */
+    template<typename Source, typename Decode>
+    void readChunks(Source& file, std::size_t count, std::size_t threads, Decode decode) {
+      uint64_t stored;
+      file >> stored;
+      if (stored != count) {
+        throw std::runtime_error("Chunk count mismatch");
+      }
+
+      std::vector<std::size_t> offsets(count + 1, 0);
+      for (std::size_t i = 0; i < count; i++) {
+        uint64_t size;
+        file >> size;
+        if (size > SIZE_MAX - offsets[i]) {
+          throw std::runtime_error("Corrupted chunks");
+        }
+        offsets[i + 1] = offsets[i] + static_cast<std::size_t>(size);
+      }
+
+      // the chunks are decoded straight from a mapping or a buffer
+      std::vector<std::byte> buffer;
+      const std::byte* data;
+      if (viewable(file)) {
+        data = file.view(offsets[count]);
+      } else {
+        buffer.resize(offsets[count]);
+        file.read(buffer.data(), buffer.size());
+        data = buffer.data();
+      }
+
+      parallelFor(count, threads, [&](std::size_t i) {
+        decode(i, data + offsets[i], offsets[i + 1] - offsets[i]);
+      });
+    }
+
+    // The number of chunks of `size` elements, checking the chunk size read from a file
+    inline std::size_t chunkCount(uint64_t size, uint64_t chunkSize) {
+      if (size > 0 && chunkSize == 0) {
+        throw std::runtime_error("Corrupted chunks");
+      }
+      return size == 0 ? 0 : static_cast<std::size_t>((size - 1) / chunkSize + 1);
+    }
+
+    template<typename T>
+    inline constexpr bool is_chunked_v = is_bulk_v<T> && !std::is_same_v<T, bool>;
+
+    // Encode the elements of a chunk with the operators
+    template<typename Iterator>
+    void encodeElements(Encoding encoding, Iterator first, std::size_t count, std::vector<std::byte>& out) {
+      Options options;
+      options.encoding = encoding;
+      OBinaryBuffer buffer(options);
+      for (std::size_t i = 0; i < count; i++, ++first) {
+        buffer << *first;
+      }
+      out = buffer.release();
+    }
+
+    template<typename Iterator>
+    void decodeElements(Encoding encoding, bool swapsFloats, const std::byte* data, std::size_t size, Iterator first, std::size_t count) {
+      Options options;
+      options.encoding = encoding;
+      IBinaryBuffer buffer(data, size, options, swapsFloats);
+      for (std::size_t i = 0; i < count; i++, ++first) {
+        buffer >> *first;
+      }
+      if (buffer.remaining() != 0) {
+        throw std::runtime_error("Corrupted chunks");
+      }
+    }
+
+    template<typename Sink, typename T>
+    void writeParallel(Sink& file, const T* data, std::size_t size, const Parallelism& parallelism) {
+      const std::size_t chunkSize = std::max<std::size_t>(parallelism.chunkSize, 1);
+      const Encoding encoding = file.encoding();
+      file << static_cast<uint64_t>(size) << static_cast<uint64_t>(chunkSize);
+
+      writeChunks(file, chunkCount(size, chunkSize), parallelism.threads, [&](std::size_t i, std::vector<std::byte>& out) {
+        const std::size_t first = i * chunkSize;
+        const std::size_t count = std::min(chunkSize, size - first);
+        if constexpr (is_chunked_v<T>) {
+          encodeBulk(encoding, data + first, count, out);
+        } else {
+          encodeElements(encoding, data + first, count, out);
+        }
+      });
+    }
+
+    // `resize(size)` allocates the container and returns where to decode the values
+    template<typename T, typename Source, typename Resize>
+    void readParallel(Source& file, Resize resize, const Parallelism& parallelism) {
+      uint64_t size, chunkSize;
+      file >> size >> chunkSize;
+      const std::size_t count = chunkCount(size, chunkSize);
+      T* data = resize(static_cast<std::size_t>(size));
+      const Encoding encoding = file.encoding();
+      const bool swapsFloats = file.swapsFloats();
+
+      readChunks(file, count, parallelism.threads, [&](std::size_t i, const std::byte* chunk, std::size_t bytes) {
+        const std::size_t first = i * static_cast<std::size_t>(chunkSize);
+        const std::size_t n = std::min(static_cast<std::size_t>(chunkSize), static_cast<std::size_t>(size) - first);
+        if constexpr (is_chunked_v<T>) {
+          if (decodeBulk(encoding, chunk, bytes, data + first, n) != bytes) {
+            throw std::runtime_error("Corrupted chunks");
+          }
+          if constexpr (std::is_floating_point_v<T>) {
+            if (swapsFloats) {
+              swapFloats(reinterpret_cast<std::byte*>(data + first), n, sizeof(T));
+            }
+          }
+        } else {
+          decodeElements(encoding, swapsFloats, chunk, bytes, data + first, n);
+        }
+      });
+    }
+
+    template<typename Sink, typename T>
+    void writeParallel(Sink& file, const std::vector<T>& x, const Parallelism& parallelism) {
+      static_assert(!std::is_same_v<T, bool>, "vectors of bool can not be encoded in parallel");
+      writeParallel(file, x.data(), x.size(), parallelism);
+    }
+
+    template<typename Source, typename T>
+    void readParallel(Source& file, std::vector<T>& x, const Parallelism& parallelism) {
+      static_assert(!std::is_same_v<T, bool>, "vectors of bool can not be decoded in parallel");
+      readParallel<T>(file, [&x](std::size_t size) {
+        x.resize(size);
+        return x.data();
+      }, parallelism);
+    }
+
+    template<typename Sink>
+    void writeParallel(Sink& file, const std::string& x, const Parallelism& parallelism) {
+      writeParallel(file, x.data(), x.size(), parallelism);
+    }
+
+    template<typename Source>
+    void readParallel(Source& file, std::string& x, const Parallelism& parallelism) {
+      readParallel<char>(file, [&x](std::size_t size) {
+        x.resize(size);
+        return x.data();
+      }, parallelism);
+    }
+
+    // Each chunk of a map of primitive values holds its keys, then its
+    // values, the other maps hold the entries one after the other
+    template<typename Sink, typename K, typename V>
+    void writeParallel(Sink& file, const std::map<K, V>& x, const Parallelism& parallelism) {
+      const std::size_t chunkSize = std::max<std::size_t>(parallelism.chunkSize, 1);
+      const std::size_t count = chunkCount(x.size(), chunkSize);
+      const Encoding encoding = file.encoding();
+      file << static_cast<uint64_t>(x.size()) << static_cast<uint64_t>(chunkSize);
+
+      // the first entry of each chunk
+      std::vector<typename std::map<K, V>::const_iterator> starts;
+      starts.reserve(count);
+      std::size_t index = 0;
+      for (auto it = x.begin(); it != x.end(); ++it, ++index) {
+        if (index % chunkSize == 0) {
+          starts.push_back(it);
+        }
+      }
+
+      writeChunks(file, count, parallelism.threads, [&](std::size_t i, std::vector<std::byte>& out) {
+        const std::size_t n = std::min(chunkSize, x.size() - i * chunkSize);
+        if constexpr (is_chunked_v<K> && is_chunked_v<V>) {
+          std::vector<K> keys;
+          std::vector<V> values;
+          keys.reserve(n);
+          values.reserve(n);
+          auto it = starts[i];
+          for (std::size_t j = 0; j < n; j++, ++it) {
+            keys.push_back(it->first);
+            values.push_back(it->second);
+          }
+          encodeBulk(encoding, keys.data(), n, out);
+          encodeBulk(encoding, values.data(), n, out);
+        } else {
+          Options options;
+          options.encoding = encoding;
+          OBinaryBuffer buffer(options);
+          auto it = starts[i];
+          for (std::size_t j = 0; j < n; j++, ++it) {
+            buffer << it->first << it->second;
+          }
+          out = buffer.release();
+        }
+      });
+    }
+
+    // The entries are decoded concurrently, then inserted in order
+    template<typename Source, typename K, typename V>
+    void readParallel(Source& file, std::map<K, V>& x, const Parallelism& parallelism) {
+      uint64_t size, chunkSize;
+      file >> size >> chunkSize;
+      const std::size_t count = chunkCount(size, chunkSize);
+      std::vector<std::pair<K, V>> entries(static_cast<std::size_t>(size));
+      const Encoding encoding = file.encoding();
+      const bool swapsFloats = file.swapsFloats();
+
+      readChunks(file, count, parallelism.threads, [&](std::size_t i, const std::byte* chunk, std::size_t bytes) {
+        const std::size_t first = i * static_cast<std::size_t>(chunkSize);
+        const std::size_t n = std::min(static_cast<std::size_t>(chunkSize), entries.size() - first);
+        if constexpr (is_chunked_v<K> && is_chunked_v<V>) {
+          std::vector<K> keys(n);
+          std::vector<V> values(n);
+          const std::size_t used = decodeBulk(encoding, chunk, bytes, keys.data(), n);
+          if (used + decodeBulk(encoding, chunk + used, bytes - used, values.data(), n) != bytes) {
+            throw std::runtime_error("Corrupted chunks");
+          }
+          if (swapsFloats) {
+            if constexpr (std::is_floating_point_v<K>) {
+              swapFloats(reinterpret_cast<std::byte*>(keys.data()), n, sizeof(K));
+            }
+            if constexpr (std::is_floating_point_v<V>) {
+              swapFloats(reinterpret_cast<std::byte*>(values.data()), n, sizeof(V));
+            }
+          }
+          for (std::size_t j = 0; j < n; j++) {
+            entries[first + j].first = keys[j];
+            entries[first + j].second = values[j];
+          }
+        } else {
+          Options options;
+          options.encoding = encoding;
+          IBinaryBuffer buffer(chunk, bytes, options, swapsFloats);
+          for (std::size_t j = 0; j < n; j++) {
+            buffer >> entries[first + j].first >> entries[first + j].second;
+          }
+          if (buffer.remaining() != 0) {
+            throw std::runtime_error("Corrupted chunks");
+          }
+        }
+      });
+
+      x.clear();
+      for (auto& entry : entries) {
+        x.emplace_hint(x.end(), std::move(entry.first), std::move(entry.second));
+      }
+    }
+
+  } // namespace detail
+
+  template<typename Sink, typename Container>
+  detail::sink_t<Sink> operator<<(Sink& file, const Parallel<Container>& x) {
+    detail::writeParallel(file, x.value(), x.parallelism());
+    return file;
+  }
+
+  template<typename Source, typename Container>
+  detail::source_t<Source> operator>>(Source& file, const Parallel<Container>& x) {
+    detail::readParallel(file, x.value(), x.parallelism());
+    return file;
+  }
+
+  /**
+   * @brief An input range over the elements of a serialized `std::vector<T>`
+   *
+   * The constructor reads the size of the vector, then the elements are
+   * decoded as the range is iterated, `chunkSize` elements at a time, so the
+   * vector is never held in memory. The range reads from the file: nothing
+   * else must be read from it until the iteration is over.
+   */
+  template<typename T, typename Source = IBinaryFile>
+  class VectorRange {
+  public:
+    /**
+     * @brief The default number of elements decoded at once
+     */
+    static constexpr std::size_t DefaultChunkSize = 4096;
+
+    class iterator {
+    public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type = T;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const T*;
+      using reference = const T&;
+
+      iterator() : range_(nullptr) { }
+      explicit iterator(VectorRange* range) : range_(range) { }
+
+      reference operator*() const { return range_->chunk_[range_->index_]; }
+      pointer operator->() const { return &range_->chunk_[range_->index_]; }
+
+      iterator& operator++() {
+        range_->next();
+        return *this;
+      }
+
+      void operator++(int) {
+        range_->next();
+      }
+
+      bool operator==(const iterator& other) const { return atEnd() == other.atEnd(); }
+      bool operator!=(const iterator& other) const { return !(*this == other); }
+
+    private:
+      bool atEnd() const { return range_ == nullptr || range_->done(); }
+
+      VectorRange* range_;
+    };
+
+    /**
+     * @brief Constructor
+     *
+     * Reads the size of the vector from `file`.
+     */
+    explicit VectorRange(Source& file, std::size_t chunkSize = DefaultChunkSize) :
+      file_(file),
+      chunk_(std::make_unique<T[]>(chunkSize > 0 ? chunkSize : 1)),
+      capacity_(chunkSize > 0 ? chunkSize : 1),
+      count_(0),
+      index_(0) {
+      file_ >> size_;
+      remaining_ = size_;
+      fill();
+    }
+
+    VectorRange(const VectorRange& other) = delete;
+    VectorRange& operator=(const VectorRange& other) = delete;
+
+    /**
+     * @brief The number of elements of the vector
+     */
+    uint64_t size() const {
+      return size_;
+    }
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+  private:
+    bool done() const {
+      return index_ == count_;
+    }
+
+    void next() {
+      if (++index_ == count_) {
+        fill();
+      }
+    }
+
+    // Decode the next chunk of elements
+    void fill() {
+      count_ = static_cast<std::size_t>(std::min<uint64_t>(remaining_, capacity_));
+      index_ = 0;
+      remaining_ -= count_;
+
+      if constexpr (detail::is_bulk_v<T>) {
+        detail::readBulk(file_, chunk_.get(), count_);
+      } else {
+        for (std::size_t i = 0; i < count_; i++) {
+          file_ >> chunk_[i];
+        }
+      }
+    }
+
+    Source& file_;
+    std::unique_ptr<T[]> chunk_;
+    std::size_t capacity_;
+    std::size_t count_;
+    std::size_t index_;
+    uint64_t size_;
+    uint64_t remaining_;
+  };
+
+  template<typename Source, typename K, typename V, typename Compare, typename Alloc>
+  detail::source_t<Source> operator>>(Source& file, std::map<K, V, Compare, Alloc>& x) {
+    uint64_t size; file >> size;
+    detail::StatsAccess::container(file, size);
+    x.clear();
+
+    // the keys were written in order, so each one goes at the end
+    for (uint64_t i = 0; i < size; i++) {
+      K key = detail::makeElement<K>(x.get_allocator());
+      V value = detail::makeElement<V>(x.get_allocator());
+      file >> key >> value;
+      x.emplace_hint(x.end(), std::move(key), std::move(value));
+    }
+    return file;
+  }
+
+  template<typename Source, typename T, typename Compare, typename Alloc>
+  detail::source_t<Source> operator>>(Source& file, std::set<T, Compare, Alloc>& x) {
+    uint64_t size; file >> size;
+    detail::StatsAccess::container(file, size);
+    x.clear();
+
+    for (uint64_t i = 0; i < size; i++) {
+      T value = detail::makeElement<T>(x.get_allocator());
+      file >> value;
+      x.emplace_hint(x.end(), std::move(value));
+    }
+    return file;
+  }
+
+  /**
+   * @brief Read a `std::unordered_map`, or a `std::map` that was written
+   *
+   * The buckets are allocated for the size before the elements are
+   * inserted.
+   */
+  template<typename Source, typename K, typename V, typename Hash, typename KeyEqual, typename Alloc>
+  detail::source_t<Source> operator>>(Source& file, std::unordered_map<K, V, Hash, KeyEqual, Alloc>& x) {
+    uint64_t size; file >> size;
+    detail::StatsAccess::container(file, size);
+    detail::readTable(file, x, size, 0);
+    return file;
+  }
+
+  /**
+   * @brief Read a `std::unordered_set`, or a `std::set` that was written
+   *
+   * The buckets are allocated for the size before the elements are
+   * inserted.
+   */
+  template<typename Source, typename T, typename Hash, typename KeyEqual, typename Alloc>
+  detail::source_t<Source> operator>>(Source& file, std::unordered_set<T, Hash, KeyEqual, Alloc>& x) {
+    uint64_t size; file >> size;
+    detail::StatsAccess::container(file, size);
+    detail::readTable(file, x, size, 0);
+    return file;
+  }
+
+  /**
+   * @brief A `std::unordered_map` or `std::unordered_set`, stored with its
+   * bucket count
+   *
+   * The reader allocates at least as many buckets before inserting the
+   * elements, so the table gets back its load factor. The elements follow
+   * the size and the bucket count. Use `buckets()` to build it.
+   */
+  template<typename Table>
+  class Buckets {
+  public:
+    explicit Buckets(Table& table) : table_(table) { }
+
+    Table& table() const {
+      return table_;
+    }
+
+  private:
+    Table& table_;
+  };
+
+  template<typename Table>
+  Buckets<Table> buckets(Table& table) {
+    return Buckets<Table>(table);
+  }
+
+  template<typename Sink, typename Table>
+  detail::sink_t<Sink> operator<<(Sink& file, const Buckets<Table>& x) {
+    const auto size = static_cast<uint64_t>(x.table().size());
+    detail::StatsAccess::container(file, size);
+    file << size << static_cast<uint64_t>(x.table().bucket_count());
+    detail::writeTable(file, x.table());
+    return file;
+  }
+
+  template<typename Source, typename Table>
+  detail::source_t<Source> operator>>(Source& file, const Buckets<Table>& x) {
+    uint64_t size, bucketCount;
+    file >> size >> bucketCount;
+    detail::StatsAccess::container(file, size);
+    detail::readTable(file, x.table(), size, bucketCount);
+    return file;
+  }
+
+  /**
+   * @brief A `std::set` or a `std::map` with integral keys, whose keys are
+   * stored as bit-packed gaps
+   *
+   * The first key is followed by blocks of `PackBlockSize` keys. Each block
+   * holds the bit width of its largest gap, as one byte, then the gaps
+   * between consecutive keys minus one, packed on this width: a range of
+   * consecutive keys takes one byte per block. The values of a map follow
+   * the keys of their block. Use `packed()` to build it.
+   */
+  template<typename Container>
+  class Packed {
+  public:
+    using key_type = typename std::remove_const_t<Container>::key_type;
+
+    static_assert(std::is_integral_v<key_type> && !std::is_same_v<key_type, bool>, "the keys must be integers");
+    static_assert(std::is_same_v<typename std::remove_const_t<Container>::key_compare, std::less<key_type>>, "the keys must be in increasing order");
+
+    explicit Packed(Container& value) : value_(value) { }
+
+    Container& value() const {
+      return value_;
+    }
+
+  private:
+    Container& value_;
+  };
+
+  template<typename Container>
+  Packed<Container> packed(Container& value) {
+    return Packed<Container>(value);
+  }
+
+  /**
+   * @brief Number of keys of each block of a `Packed` container
+   */
+  constexpr std::size_t PackBlockSize = 128;
+
+  namespace detail {
+
+    // Map the keys to unsigned integers in the same order
+    template<typename T>
+    uint64_t orderedBits(T x) {
+      if constexpr (std::is_signed_v<T>) {
+        return static_cast<uint64_t>(static_cast<int64_t>(x)) ^ (uint64_t(1) << 63);
+      } else {
+        return static_cast<uint64_t>(x);
+      }
+    }
+
+    template<typename T>
+    T fromOrderedBits(uint64_t x) {
+      if constexpr (std::is_signed_v<T>) {
+        return static_cast<T>(static_cast<int64_t>(x ^ (uint64_t(1) << 63)));
+      } else {
+        return static_cast<T>(x);
+      }
+    }
+
+  } // namespace detail
+
+  template<typename Sink, typename Container>
+  detail::sink_t<Sink> operator<<(Sink& file, const Packed<Container>& x) {
+    using Key = typename Packed<Container>::key_type;
+    const auto& container = x.value();
+    const auto size = static_cast<uint64_t>(container.size());
+    detail::StatsAccess::container(file, size);
+    file << size;
+    if (container.empty()) {
+      return file;
+    }
+
+    const auto keyOf = [](const auto& elem) -> Key {
+      if constexpr (detail::is_key_table_v<std::remove_const_t<Container>>) {
+        return elem;
+      } else {
+        return elem.first;
+      }
+    };
+
+    // the gap before the first key is 0
+    uint64_t prev = detail::orderedBits(keyOf(*container.begin()));
+    file << prev;
+    prev--;
+
+    uint64_t gaps[PackBlockSize];
+    std::byte packed[PackBlockSize * sizeof(uint64_t)];
+    auto it = container.begin();
+    while (it != container.end()) {
+      const auto first = it;
+      std::size_t count = 0;
+      uint64_t widest = 0;
+      for (; it != container.end() && count < PackBlockSize; ++it, ++count) {
+        const uint64_t key = detail::orderedBits(keyOf(*it));
+        gaps[count] = key - prev - 1;
+        widest |= gaps[count];
+        prev = key;
+      }
+
+      const unsigned width = bitWidth(widest);
+      file << static_cast<uint8_t>(width);
+      file.write(packed, packBits(gaps, count, width, packed));
+
+      if constexpr (!detail::is_key_table_v<std::remove_const_t<Container>>) {
+        for (auto value = first; value != it; ++value) {
+          file << value->second;
+        }
+      }
+    }
+    return file;
+  }
+
+  /**
+   * @brief Read the keys of a `Packed` container block by block
+   *
+   * Throws a `std::runtime_error` if a bit width is larger than 64.
+   */
+  template<typename Source, typename Container>
+  detail::source_t<Source> operator>>(Source& file, const Packed<Container>& x) {
+    using Key = typename Packed<Container>::key_type;
+    auto& container = x.value();
+    uint64_t size; file >> size;
+    detail::StatsAccess::container(file, size);
+    container.clear();
+    if (size == 0) {
+      return file;
+    }
+
+    uint64_t prev;
+    file >> prev;
+    prev--;
+
+    uint64_t keys[PackBlockSize];
+    // the unpacking reads 8 bytes past the packed ones
+    std::byte packed[PackBlockSize * sizeof(uint64_t) + sizeof(uint64_t)] = {};
+    for (uint64_t remaining = size; remaining > 0; ) {
+      const auto count = static_cast<std::size_t>(std::min<uint64_t>(remaining, PackBlockSize));
+      remaining -= count;
+
+      uint8_t width;
+      file >> width;
+      if (width > 64) {
+        throw std::runtime_error("Corrupted packed keys");
+      }
+      file.read(packed, (count * width + 7) / 8);
+      unpackBits(packed, count, width, keys);
+      prev = addGaps(keys, count, prev);
+
+      // the keys are in order, so each one goes at the end
+      for (std::size_t i = 0; i < count; i++) {
+        const Key key = detail::fromOrderedBits<Key>(keys[i]);
+        if constexpr (detail::is_key_table_v<Container>) {
+          container.emplace_hint(container.end(), key);
+        } else {
+          auto value = detail::makeElement<typename Container::mapped_type>(container.get_allocator());
+          file >> value;
+          container.emplace_hint(container.end(), key, std::move(value));
+        }
+      }
+    }
+    return file;
+  }
+
+  /**
+   * @brief A `std::vector<std::string>` or a `std::vector<std::vector<T>>`
+   * stored as one array of offsets and one blob
+   *
+   * The size of the vector is followed by the end offset of each element, in
+   * characters or values of `T`, then by all the elements one after the
+   * other. The reader needs two bulk reads, and the strings can be viewed
+   * without copying them with `StringsView`. Use `flat()` to build it.
+   */
+  template<typename Vector>
+  class Flat {
+  public:
+    using list_type = typename std::remove_const_t<Vector>::value_type;
+    using value_type = typename list_type::value_type;
+
+    static_assert(detail::is_chunked_v<value_type>, "the elements must be vectors of primitive values other than bool, or strings");
+
+    explicit Flat(Vector& value) : value_(value) { }
+
+    Vector& value() const {
+      return value_;
+    }
+
+  private:
+    Vector& value_;
+  };
+
+  template<typename Vector>
+  Flat<Vector> flat(Vector& value) {
+    return Flat<Vector>(value);
+  }
+
+  namespace detail {
+
+    /**
+     * @brief Read the end offsets of the `size` elements of a `Flat` vector
+     *
+     * Throws a `std::runtime_error` if they are not in order.
+     */
+    template<typename Source>
+    std::vector<uint64_t> readOffsets(Source& file, uint64_t size) {
+      std::vector<uint64_t> offsets(static_cast<std::size_t>(size));
+      readBulk(file, offsets.data(), offsets.size());
+      if (!std::is_sorted(offsets.begin(), offsets.end()) || (!offsets.empty() && offsets.back() > SIZE_MAX)) {
+        throw std::runtime_error("Corrupted offsets");
+      }
+      return offsets;
+    }
+
+  } // namespace detail
+
+  template<typename Sink, typename Vector>
+  detail::sink_t<Sink> operator<<(Sink& file, const Flat<Vector>& x) {
+    using T = typename Flat<Vector>::value_type;
+    const auto& lists = x.value();
+    const auto size = static_cast<uint64_t>(lists.size());
+    detail::StatsAccess::container(file, size);
+    file << size;
+
+    std::vector<uint64_t> offsets;
+    offsets.reserve(lists.size());
+    uint64_t offset = 0;
+    for (const auto& list : lists) {
+      offset += list.size();
+      offsets.push_back(offset);
+    }
+    detail::writeBulk(file, offsets.data(), offsets.size());
+
+    for (const auto& list : lists) {
+      if constexpr (std::is_same_v<T, char>) {
+        file.write(reinterpret_cast<const std::byte*>(list.data()), list.size());
+      } else {
+        detail::writeBulk(file, list.data(), list.size());
+      }
+    }
+    return file;
+  }
+
+  template<typename Source, typename Vector>
+  detail::source_t<Source> operator>>(Source& file, const Flat<Vector>& x) {
+    using T = typename Flat<Vector>::value_type;
+    uint64_t size; file >> size;
+    detail::StatsAccess::container(file, size);
+    const std::vector<uint64_t> offsets = detail::readOffsets(file, size);
+    const auto total = static_cast<std::size_t>(offsets.empty() ? 0 : offsets.back());
+
+    // the blob is read at once, straight from a mapping if it holds characters
+    std::vector<T> blob;
+    const T* data;
+    if constexpr (std::is_same_v<T, char>) {
+      if (detail::viewable(file)) {
+        data = reinterpret_cast<const char*>(file.view(total));
+      } else {
+        blob.resize(total);
+        file.read(reinterpret_cast<std::byte*>(blob.data()), total);
+        data = blob.data();
+      }
+    } else {
+      blob.resize(total);
+      detail::readBulk(file, blob.data(), total);
+      data = blob.data();
+    }
+
+    auto& lists = x.value();
+    lists.resize(offsets.size());
+    std::size_t begin = 0;
+    for (std::size_t i = 0; i < offsets.size(); i++) {
+      const auto end = static_cast<std::size_t>(offsets[i]);
+      lists[i].assign(data + begin, data + end);
+      begin = end;
+    }
+    return file;
+  }
+
+  /**
+   * @brief The strings of a `std::vector<std::string>` written with
+   * `flat()`, read without copying each of them
+   *
+   * The views point in the mapping of a mapped file, which must stay open,
+   * or in one buffer that the list owns otherwise.
+   */
+  class StringsView {
+  public:
+    std::size_t size() const {
+      return offsets_.size();
+    }
+
+    bool empty() const {
+      return offsets_.empty();
+    }
+
+    std::string_view operator[](std::size_t i) const {
+      const std::size_t begin = i == 0 ? 0 : static_cast<std::size_t>(offsets_[i - 1]);
+      return std::string_view(data() + begin, static_cast<std::size_t>(offsets_[i]) - begin);
+    }
+
+  private:
+    const char* data() const {
+      return storage_.empty() ? view_ : storage_.data();
+    }
+
+    std::vector<uint64_t> offsets_;
+    std::vector<char> storage_;
+    const char* view_ = nullptr;
+
+    template<typename Source>
+    friend detail::source_t<Source> operator>>(Source& file, StringsView& x);
+  };
+
+  template<typename Source>
+  detail::source_t<Source> operator>>(Source& file, StringsView& x) {
+    uint64_t size; file >> size;
+    detail::StatsAccess::container(file, size);
+    x.offsets_ = detail::readOffsets(file, size);
+    const auto total = static_cast<std::size_t>(x.offsets_.empty() ? 0 : x.offsets_.back());
+
+    x.storage_.clear();
+    x.view_ = nullptr;
+    if (detail::viewable(file)) {
+      x.view_ = reinterpret_cast<const char*>(file.view(total));
+    } else {
+      x.storage_.resize(total);
+      file.read(reinterpret_cast<std::byte*>(x.storage_.data()), total);
+    }
+    return file;
+  }
+
+  /**
+   * @brief How `Floats` transforms the values before compressing them
+   */
+  enum class FloatCodec : uint8_t {
+    Shuffle = 0, ///< the bytes of the values are grouped by position
+    Xor = 1,     ///< each value is XORed with the previous one, then shuffled
+  };
+
+  /**
+   * @brief A `std::vector` or a `std::array` of `float` or `double`,
+   * compressed without loss
+   *
+   * The values are split in chunks of `FloatChunkSize`. The bytes of each
+   * chunk are grouped by position, after the XOR of each value with the
+   * previous one for `FloatCodec::Xor`, and compressed with the built-in LZ
+   * codec: the bytes that slowly changing series share become runs. The
+   * size and the codec are followed by the size and the block of each
+   * chunk. Use `floats()` to build it.
+   */
+  template<typename Container>
+  class Floats {
+  public:
+    using value_type = typename std::remove_const_t<Container>::value_type;
+
+    static_assert(std::is_same_v<value_type, float> || std::is_same_v<value_type, double>, "the values must be float or double");
+
+    Floats(Container& value, FloatCodec codec) : value_(value), codec_(codec) { }
+
+    Container& value() const {
+      return value_;
+    }
+
+    FloatCodec codec() const {
+      return codec_;
+    }
+
+  private:
+    Container& value_;
+    FloatCodec codec_;
+  };
+
+  template<typename Container>
+  Floats<Container> floats(Container& value, FloatCodec codec = FloatCodec::Xor) {
+    return Floats<Container>(value, codec);
+  }
+
+  /**
+   * @brief Number of values of each chunk of `Floats`
+   */
+  constexpr std::size_t FloatChunkSize = std::size_t(1) << 16;
+
+  namespace detail {
+
+    /**
+     * @brief Encode `count` values of `width` bytes pointed by `data` in a
+     * block, stored in `out`
+     */
+    void encodeFloats(FloatCodec codec, const std::byte* data, std::size_t count, std::size_t width, std::vector<std::byte>& out);
+
+    /**
+     * @brief Decode the `size` bytes of a block of `encodeFloats()` in the
+     * `count` values of `width` bytes pointed by `out`
+     *
+     * Throws a `std::runtime_error` if the block does not hold these values.
+     */
+    void decodeFloats(FloatCodec codec, const std::byte* data, std::size_t size, std::byte* out, std::size_t count, std::size_t width);
+
+    template<typename T, typename Alloc>
+    void resizeFloats(std::vector<T, Alloc>& x, uint64_t size) {
+      x.resize(static_cast<std::size_t>(size));
+    }
+
+    template<typename T, std::size_t N>
+    void resizeFloats(std::array<T, N>&, uint64_t size) {
+      if (size != N) {
+        throw std::runtime_error("Size mismatch");
+      }
+    }
+
+  } // namespace detail
+
+  template<typename Sink, typename Container>
+  detail::sink_t<Sink> operator<<(Sink& file, const Floats<Container>& x) {
+    using T = typename Floats<Container>::value_type;
+    const auto& values = x.value();
+    const auto size = static_cast<uint64_t>(values.size());
+    detail::StatsAccess::container(file, size);
+    file << size << static_cast<uint8_t>(x.codec());
+
+    std::vector<std::byte> block;
+    for (std::size_t first = 0; first < values.size(); first += FloatChunkSize) {
+      const std::size_t count = std::min(FloatChunkSize, values.size() - first);
+      detail::encodeFloats(x.codec(), reinterpret_cast<const std::byte*>(values.data() + first), count, sizeof(T), block);
+      file << static_cast<uint64_t>(block.size());
+      file.write(block.data(), block.size());
+    }
+    return file;
+  }
+
+  /**
+   * @brief Read the values of `Floats`, straight from the mapping if the file
+   * is mapped
+   *
+   * Throws a `std::runtime_error` if the codec is unknown, or if an array
+   * does not have the size that was written.
+   */
+  template<typename Source, typename Container>
+  detail::source_t<Source> operator>>(Source& file, const Floats<Container>& x) {
+    using T = typename Floats<Container>::value_type;
+    uint64_t size;
+    uint8_t codec;
+    file >> size >> codec;
+    detail::StatsAccess::container(file, size);
+    if (codec > static_cast<uint8_t>(FloatCodec::Xor)) {
+      throw std::runtime_error("Unknown float codec");
+    }
+
+    auto& values = x.value();
+    detail::resizeFloats(values, size);
+
+    std::vector<std::byte> buffer;
+    for (std::size_t first = 0; first < values.size(); first += FloatChunkSize) {
+      const std::size_t count = std::min(FloatChunkSize, values.size() - first);
+      uint64_t stored;
+      file >> stored;
+
+      const std::byte* data;
+      if (detail::viewable(file)) {
+        data = file.view(static_cast<std::size_t>(stored));
+      } else {
+        buffer.resize(static_cast<std::size_t>(stored));
+        file.read(buffer.data(), buffer.size());
+        data = buffer.data();
+      }
+      detail::decodeFloats(static_cast<FloatCodec>(codec), data, static_cast<std::size_t>(stored), reinterpret_cast<std::byte*>(values.data() + first), count, sizeof(T));
+      if (file.swapsFloats()) {
+        detail::swapFloats(reinterpret_cast<std::byte*>(values.data() + first), count, sizeof(T));
+      }
+    }
+    return file;
+  }
+
+  /**
+   * @brief Read a `T` whose memory comes from `resource`
+   *
+   * `T` is usually a `std::pmr` container: its nodes and elements, and the
+   * ones of the containers it holds, are allocated from `resource`. With a
+   * `std::pmr::monotonic_buffer_resource`, the whole value is freed at once
+   * with the resource, and its destructor has nothing to free.
+   */
+  template<typename T, typename Source>
+  T load(Source& file, std::pmr::memory_resource& resource) {
+    T value = detail::makeElement<T>(std::pmr::polymorphic_allocator<std::byte>(&resource));
+    file >> value;
+    return value;
   }
 
 } // namespace serial
@@ -0,0 +1,162 @@
+#include "Shuffle.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#define SERIAL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace serial {
+
+    namespace {
+
+        template<typename U>
+        void shuffleScalar(std::byte* dst, const std::byte* src, std::size_t count, bool xorDelta) {
+            U prev = 0;
+            for (std::size_t i = 0; i < count; i++) {
+                U x;
+                std::memcpy(&x, src + i * sizeof(U), sizeof(U));
+                const U y = xorDelta ? x ^ prev : x;
+                prev = x;
+                for (std::size_t k = 0; k < sizeof(U); k++) {
+                    dst[k * count + i] = static_cast<std::byte>(y >> (8 * k));
+                }
+            }
+        }
+
+        // Unshuffle the values from `first`, the planes holding `count` bytes
+        // each, `prev` being the value before `first`
+        template<typename U>
+        void unshuffleScalar(std::byte* dst, const std::byte* src, std::size_t count, std::size_t first, U prev, bool xorDelta) {
+            for (std::size_t i = first; i < count; i++) {
+                U y = 0;
+                for (std::size_t k = 0; k < sizeof(U); k++) {
+                    y |= static_cast<U>(std::to_integer<U>(src[k * count + i]) << (8 * k));
+                }
+                const U x = xorDelta ? y ^ prev : y;
+                prev = x;
+                std::memcpy(dst + i * sizeof(U), &x, sizeof(U));
+            }
+        }
+
+#ifdef SERIAL_SSE2
+
+        // The planes are transposed 16 values at a time with the unpack
+        // instructions, then the XORs are undone in each register with a
+        // prefix XOR of its lanes
+
+        void sse2Unshuffle64(std::byte* dst, const std::byte* src, std::size_t count, bool xorDelta) {
+            __m128i carry = _mm_setzero_si128();
+            std::size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                __m128i p[8];
+                for (std::size_t k = 0; k < 8; k++) {
+                    p[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k * count + i));
+                }
+
+                // pairs of bytes, then groups of 4 bytes of the values
+                const __m128i a0 = _mm_unpacklo_epi8(p[0], p[1]), a1 = _mm_unpackhi_epi8(p[0], p[1]);
+                const __m128i b0 = _mm_unpacklo_epi8(p[2], p[3]), b1 = _mm_unpackhi_epi8(p[2], p[3]);
+                const __m128i c0 = _mm_unpacklo_epi8(p[4], p[5]), c1 = _mm_unpackhi_epi8(p[4], p[5]);
+                const __m128i d0 = _mm_unpacklo_epi8(p[6], p[7]), d1 = _mm_unpackhi_epi8(p[6], p[7]);
+                const __m128i e[4] = { _mm_unpacklo_epi16(a0, b0), _mm_unpackhi_epi16(a0, b0), _mm_unpacklo_epi16(a1, b1), _mm_unpackhi_epi16(a1, b1) };
+                const __m128i f[4] = { _mm_unpacklo_epi16(c0, d0), _mm_unpackhi_epi16(c0, d0), _mm_unpacklo_epi16(c1, d1), _mm_unpackhi_epi16(c1, d1) };
+
+                for (std::size_t r = 0; r < 8; r++) {
+                    __m128i v = r % 2 == 0 ? _mm_unpacklo_epi32(e[r / 2], f[r / 2]) : _mm_unpackhi_epi32(e[r / 2], f[r / 2]);
+                    if (xorDelta) {
+                        v = _mm_xor_si128(v, _mm_slli_si128(v, 8));
+                        v = _mm_xor_si128(v, carry);
+                        carry = _mm_unpackhi_epi64(v, v);
+                    }
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i + 2 * r) * 8), v);
+                }
+            }
+
+            uint64_t prev = 0;
+            if (i > 0) {
+                std::memcpy(&prev, dst + (i - 1) * 8, 8);
+            }
+            unshuffleScalar<uint64_t>(dst, src, count, i, prev, xorDelta);
+        }
+
+        void sse2Unshuffle32(std::byte* dst, const std::byte* src, std::size_t count, bool xorDelta) {
+            __m128i carry = _mm_setzero_si128();
+            std::size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                __m128i p[4];
+                for (std::size_t k = 0; k < 4; k++) {
+                    p[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k * count + i));
+                }
+
+                const __m128i a0 = _mm_unpacklo_epi8(p[0], p[1]), a1 = _mm_unpackhi_epi8(p[0], p[1]);
+                const __m128i b0 = _mm_unpacklo_epi8(p[2], p[3]), b1 = _mm_unpackhi_epi8(p[2], p[3]);
+                const __m128i out[4] = { _mm_unpacklo_epi16(a0, b0), _mm_unpackhi_epi16(a0, b0), _mm_unpacklo_epi16(a1, b1), _mm_unpackhi_epi16(a1, b1) };
+
+                for (std::size_t r = 0; r < 4; r++) {
+                    __m128i v = out[r];
+                    if (xorDelta) {
+                        v = _mm_xor_si128(v, _mm_slli_si128(v, 4));
+                        v = _mm_xor_si128(v, _mm_slli_si128(v, 8));
+                        v = _mm_xor_si128(v, carry);
+                        carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+                    }
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i + 4 * r) * 4), v);
+                }
+            }
+
+            uint32_t prev = 0;
+            if (i > 0) {
+                std::memcpy(&prev, dst + (i - 1) * 4, 4);
+            }
+            unshuffleScalar<uint32_t>(dst, src, count, i, prev, xorDelta);
+        }
+
+#endif // SERIAL_SSE2
+
+    }
+
+    void shuffleBytes(std::byte* dst, const std::byte* src, std::size_t count, std::size_t width, bool xorDelta) {
+        if (width == 8) {
+            shuffleScalar<uint64_t>(dst, src, count, xorDelta);
+        } else {
+            shuffleScalar<uint32_t>(dst, src, count, xorDelta);
+        }
+    }
+
+    void unshuffleBytes(std::byte* dst, const std::byte* src, std::size_t count, std::size_t width, bool xorDelta) {
+#ifdef SERIAL_SSE2
+        // SSE2 is part of x86-64, there is nothing to choose
+        if (width == 8) {
+            sse2Unshuffle64(dst, src, count, xorDelta);
+        } else {
+            sse2Unshuffle32(dst, src, count, xorDelta);
+        }
+#else
+        detail::unshuffleBytesScalar(dst, src, count, width, xorDelta);
+#endif
+    }
+
+    const char* shuffleKernel() {
+#ifdef SERIAL_SSE2
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    namespace detail {
+
+        void unshuffleBytesScalar(std::byte* dst, const std::byte* src, std::size_t count, std::size_t width, bool xorDelta) {
+            if (width == 8) {
+                unshuffleScalar<uint64_t>(dst, src, count, 0, 0, xorDelta);
+            } else {
+                unshuffleScalar<uint32_t>(dst, src, count, 0, 0, xorDelta);
+            }
+        }
+
+    } // namespace detail
+
+}
@@ -0,0 +1,41 @@
+#ifndef SHUFFLE_H
+#define SHUFFLE_H
+
+#include <cstddef>
+
+namespace serial {
+
+  /**
+   * @brief Group the bytes of `count` values of `width` bytes by position
+   *
+   * The values of `src` are read as integers in the order of the host, and
+   * `dst` gets the lowest byte of each of them, then the next one, and so
+   * on. With `xorDelta`, each value is XORed with the previous one first,
+   * so the bytes that do not change between neighbours become zeros.
+   * `width` is 4 or 8.
+   */
+  void shuffleBytes(std::byte* dst, const std::byte* src, std::size_t count, std::size_t width, bool xorDelta);
+
+  /**
+   * @brief The inverse of `shuffleBytes()`
+   */
+  void unshuffleBytes(std::byte* dst, const std::byte* src, std::size_t count, std::size_t width, bool xorDelta);
+
+  /**
+   * @brief The name of the kernel used by `unshuffleBytes()`: "sse2" or
+   * "scalar"
+   */
+  const char* shuffleKernel();
+
+  namespace detail {
+
+    /**
+     * @brief The portable version of `unshuffleBytes()`, whatever the CPU
+     */
+    void unshuffleBytesScalar(std::byte* dst, const std::byte* src, std::size_t count, std::size_t width, bool xorDelta);
+
+  } // namespace detail
+
+} // namespace serial
+
+#endif // SHUFFLE_H
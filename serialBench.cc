@@ -0,0 +1,421 @@
+#include "BitPack.h"
+#include "ByteSwap.h"
+#include "Crc32c.h"
+#include "Serial.h"
+#include "Shuffle.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+  // Number of runs of each warm measurement, the best one is kept
+  constexpr int WarmRuns = 3;
+
+  /**
+   * @brief One line of the report
+   */
+  struct Result {
+    std::string name;
+    std::size_t elements;
+    const char* operation;
+    const char* cache;
+    uint64_t bytes;
+    double seconds;
+  };
+
+  struct Settings {
+    std::string filename = "serialBench.dat";
+    bool json = false;
+    bool cold = true;
+    std::vector<std::size_t> sizes = { 1u << 10, 1u << 16, 1u << 20 };
+  };
+
+  // Keeps the compiler from dropping the values we read
+  volatile uint64_t sink;
+
+  template<typename T>
+  T makeValue(std::size_t i) {
+    if constexpr (std::is_same_v<T, bool>) {
+      return (i & 1) != 0;
+    } else if constexpr (std::is_floating_point_v<T>) {
+      return static_cast<T>(i) * static_cast<T>(0.5);
+    } else {
+      return static_cast<T>(i * 2654435761u);
+    }
+  }
+
+  uint64_t fileSize(const std::string& filename) {
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+      throw std::runtime_error("Cannot open file " + filename);
+    }
+    std::fseek(file, 0, SEEK_END);
+    const long size = std::ftell(file);
+    std::fclose(file);
+    return static_cast<uint64_t>(size);
+  }
+
+  // Write the file to the disk and drop it from the page cache
+  void evict(const std::string& filename) {
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Cannot open file " + filename);
+    }
+    ::fsync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  }
+
+  double measure(const std::function<void()>& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count();
+  }
+
+  /**
+   * @brief Measure the writing and reading of `elements` elements
+   *
+   * `write` gets an `OBinaryFile` and `read` an `IBinaryFile`.
+   */
+  template<typename Write, typename Read>
+  void run(const Settings& settings, std::vector<Result>& results, const std::string& name, std::size_t elements, Write write, Read read) {
+    double best = 0;
+    for (int i = 0; i < WarmRuns; i++) {
+      const double seconds = measure([&]() {
+        serial::OBinaryFile file(settings.filename);
+        write(file);
+      });
+      if (i == 0 || seconds < best) {
+        best = seconds;
+      }
+    }
+
+    const uint64_t bytes = fileSize(settings.filename);
+    results.push_back({ name, elements, "write", "warm", bytes, best });
+
+    for (int i = 0; i < WarmRuns; i++) {
+      const double seconds = measure([&]() {
+        serial::IBinaryFile file(settings.filename);
+        read(file);
+      });
+      if (i == 0 || seconds < best) {
+        best = seconds;
+      }
+    }
+    results.push_back({ name, elements, "read", "warm", bytes, best });
+
+    if (settings.cold) {
+      evict(settings.filename);
+      const double seconds = measure([&]() {
+        serial::IBinaryFile file(settings.filename);
+        read(file);
+      });
+      results.push_back({ name, elements, "read", "cold", bytes, seconds });
+    }
+  }
+
+  template<typename T>
+  void benchPrimitive(const Settings& settings, std::vector<Result>& results, const char* name) {
+    for (std::size_t size : settings.sizes) {
+      run(settings, results, name, size,
+        [size](serial::OBinaryFile& file) {
+          for (std::size_t i = 0; i < size; i++) {
+            file << makeValue<T>(i);
+          }
+        },
+        [size](serial::IBinaryFile& file) {
+          T value;
+          uint64_t sum = 0;
+          for (std::size_t i = 0; i < size; i++) {
+            file >> value;
+            sum += static_cast<uint64_t>(value);
+          }
+          sink = sum;
+        }
+      );
+    }
+  }
+
+  void benchString(const Settings& settings, std::vector<Result>& results) {
+    for (std::size_t size : settings.sizes) {
+      const std::string value(32, 'x');
+      run(settings, results, "string32", size,
+        [&](serial::OBinaryFile& file) {
+          for (std::size_t i = 0; i < size; i++) {
+            file << value;
+          }
+        },
+        [size](serial::IBinaryFile& file) {
+          std::string value;
+          uint64_t sum = 0;
+          for (std::size_t i = 0; i < size; i++) {
+            file >> value;
+            sum += value.size();
+          }
+          sink = sum;
+        }
+      );
+    }
+  }
+
+  template<typename T>
+  void benchVector(const Settings& settings, std::vector<Result>& results, const char* name) {
+    for (std::size_t size : settings.sizes) {
+      std::vector<T> values(size);
+      for (std::size_t i = 0; i < size; i++) {
+        values[i] = makeValue<T>(i);
+      }
+      run(settings, results, name, size,
+        [&](serial::OBinaryFile& file) {
+          file << values;
+        },
+        [](serial::IBinaryFile& file) {
+          std::vector<T> values;
+          file >> values;
+          sink = values.size();
+        }
+      );
+    }
+  }
+
+  void benchParallelVector(const Settings& settings, std::vector<Result>& results) {
+    for (std::size_t size : settings.sizes) {
+      std::vector<uint32_t> values(size);
+      for (std::size_t i = 0; i < size; i++) {
+        values[i] = makeValue<uint32_t>(i);
+      }
+      run(settings, results, "parallel vector<uint32_t>", size,
+        [&](serial::OBinaryFile& file) {
+          file << serial::parallel(values);
+        },
+        [](serial::IBinaryFile& file) {
+          std::vector<uint32_t> values;
+          file >> serial::parallel(values);
+          sink = values.size();
+        }
+      );
+    }
+  }
+
+  void benchArray(const Settings& settings, std::vector<Result>& results) {
+    constexpr std::size_t N = 256;
+    std::array<uint64_t, N> values;
+    for (std::size_t i = 0; i < N; i++) {
+      values[i] = makeValue<uint64_t>(i);
+    }
+
+    for (std::size_t size : settings.sizes) {
+      const std::size_t count = (size + N - 1) / N;
+      run(settings, results, "array<uint64_t,256>", count * N,
+        [&](serial::OBinaryFile& file) {
+          for (std::size_t i = 0; i < count; i++) {
+            file << values;
+          }
+        },
+        [count](serial::IBinaryFile& file) {
+          std::array<uint64_t, N> values;
+          uint64_t sum = 0;
+          for (std::size_t i = 0; i < count; i++) {
+            file >> values;
+            sum += values[0];
+          }
+          sink = sum;
+        }
+      );
+    }
+  }
+
+  void benchMap(const Settings& settings, std::vector<Result>& results) {
+    for (std::size_t size : settings.sizes) {
+      std::map<uint64_t, uint64_t> values;
+      for (std::size_t i = 0; i < size; i++) {
+        values.emplace(makeValue<uint64_t>(i), i);
+      }
+      run(settings, results, "map<uint64_t,uint64_t>", size,
+        [&](serial::OBinaryFile& file) {
+          file << values;
+        },
+        [](serial::IBinaryFile& file) {
+          std::map<uint64_t, uint64_t> values;
+          file >> values;
+          sink = values.size();
+        }
+      );
+    }
+  }
+
+  void benchSet(const Settings& settings, std::vector<Result>& results) {
+    for (std::size_t size : settings.sizes) {
+      std::set<uint64_t> values;
+      for (std::size_t i = 0; i < size; i++) {
+        values.insert(makeValue<uint64_t>(i));
+      }
+      run(settings, results, "set<uint64_t>", size,
+        [&](serial::OBinaryFile& file) {
+          file << values;
+        },
+        [](serial::IBinaryFile& file) {
+          std::set<uint64_t> values;
+          file >> values;
+          sink = values.size();
+        }
+      );
+    }
+  }
+
+  void benchFloats(const Settings& settings, std::vector<Result>& results) {
+    for (std::size_t size : settings.sizes) {
+      // a slowly changing series
+      std::vector<double> values(size);
+      for (std::size_t i = 0; i < size; i++) {
+        values[i] = 20.0 + static_cast<double>(i / 64) * 0.125;
+      }
+      run(settings, results, "floats vector<double>", size,
+        [&](serial::OBinaryFile& file) {
+          file << serial::floats(values);
+        },
+        [](serial::IBinaryFile& file) {
+          std::vector<double> values;
+          file >> serial::floats(values);
+          sink = values.size();
+        }
+      );
+    }
+  }
+
+  void benchPackedSet(const Settings& settings, std::vector<Result>& results) {
+    for (std::size_t size : settings.sizes) {
+      // a range of ids with a few holes
+      std::set<uint64_t> values;
+      for (std::size_t i = 0; i < size; i++) {
+        values.insert((uint64_t(1) << 40) + i + i / 64);
+      }
+      run(settings, results, "packed set<uint64_t>", size,
+        [&](serial::OBinaryFile& file) {
+          file << serial::packed(values);
+        },
+        [](serial::IBinaryFile& file) {
+          std::set<uint64_t> values;
+          file >> serial::packed(values);
+          sink = values.size();
+        }
+      );
+    }
+  }
+
+  double megabytesPerSecond(const Result& result) {
+    return result.seconds > 0 ? static_cast<double>(result.bytes) / 1e6 / result.seconds : 0;
+  }
+
+  double nanosecondsPerElement(const Result& result) {
+    return result.elements > 0 ? result.seconds * 1e9 / static_cast<double>(result.elements) : 0;
+  }
+
+  void printCsv(const std::vector<Result>& results) {
+    std::printf("name,elements,operation,cache,bytes,seconds,mb_per_s,ns_per_element\n");
+    for (const auto& result : results) {
+      std::printf("%s,%zu,%s,%s,%llu,%.9f,%.3f,%.3f\n",
+        result.name.c_str(), result.elements, result.operation, result.cache,
+        static_cast<unsigned long long>(result.bytes), result.seconds,
+        megabytesPerSecond(result), nanosecondsPerElement(result));
+    }
+  }
+
+  void printJson(const std::vector<Result>& results) {
+    std::printf("[\n");
+    for (std::size_t i = 0; i < results.size(); i++) {
+      const auto& result = results[i];
+      std::printf("  {\"name\": \"%s\", \"elements\": %zu, \"operation\": \"%s\", \"cache\": \"%s\", "
+        "\"bytes\": %llu, \"seconds\": %.9f, \"mb_per_s\": %.3f, \"ns_per_element\": %.3f}%s\n",
+        result.name.c_str(), result.elements, result.operation, result.cache,
+        static_cast<unsigned long long>(result.bytes), result.seconds,
+        megabytesPerSecond(result), nanosecondsPerElement(result),
+        i + 1 < results.size() ? "," : "");
+    }
+    std::printf("]\n");
+  }
+
+  void usage(const char* program) {
+    std::fprintf(stderr,
+      "Usage: %s [--json] [--no-cold] [--quick] [--file PATH]\n"
+      "  --json      print the results as JSON instead of CSV\n"
+      "  --no-cold   skip the reads with a cold page cache\n"
+      "  --quick     only use small sizes\n"
+      "  --file PATH the temporary file to use (default: serialBench.dat)\n",
+      program);
+  }
+
+}
+
+int main(int argc, char* argv[]) {
+  Settings settings;
+
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--json") == 0) {
+      settings.json = true;
+    } else if (std::strcmp(argv[i], "--no-cold") == 0) {
+      settings.cold = false;
+    } else if (std::strcmp(argv[i], "--quick") == 0) {
+      settings.sizes = { 1u << 10, 1u << 14 };
+    } else if (std::strcmp(argv[i], "--file") == 0 && i + 1 < argc) {
+      settings.filename = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<Result> results;
+  std::fprintf(stderr, "byte swap kernel: %s\n", serial::byteSwapKernel());
+  std::fprintf(stderr, "crc32c kernel: %s\n", serial::crc32cKernel());
+  std::fprintf(stderr, "bit pack kernel: %s\n", serial::bitPackKernel());
+  std::fprintf(stderr, "shuffle kernel: %s\n", serial::shuffleKernel());
+
+  try {
+    benchPrimitive<uint8_t>(settings, results, "uint8_t");
+    benchPrimitive<int8_t>(settings, results, "int8_t");
+    benchPrimitive<uint16_t>(settings, results, "uint16_t");
+    benchPrimitive<int16_t>(settings, results, "int16_t");
+    benchPrimitive<uint32_t>(settings, results, "uint32_t");
+    benchPrimitive<int32_t>(settings, results, "int32_t");
+    benchPrimitive<uint64_t>(settings, results, "uint64_t");
+    benchPrimitive<int64_t>(settings, results, "int64_t");
+    benchPrimitive<char>(settings, results, "char");
+    benchPrimitive<float>(settings, results, "float");
+    benchPrimitive<double>(settings, results, "double");
+    benchPrimitive<bool>(settings, results, "bool");
+    benchString(settings, results);
+    benchVector<uint32_t>(settings, results, "vector<uint32_t>");
+    benchVector<double>(settings, results, "vector<double>");
+    benchFloats(settings, results);
+    benchParallelVector(settings, results);
+    benchArray(settings, results);
+    benchMap(settings, results);
+    benchSet(settings, results);
+    benchPackedSet(settings, results);
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    std::remove(settings.filename.c_str());
+    return 1;
+  }
+
+  std::remove(settings.filename.c_str());
+
+  if (settings.json) {
+    printJson(results);
+  } else {
+    printCsv(results);
+  }
+
+  return 0;
+}
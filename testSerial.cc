@@ -1,6 +1,20 @@
 #include <gtest/gtest.h>
 
+#include "BitPack.h"
+#include "ByteSwap.h"
+#include "Compress.h"
+#include "Crc32c.h"
 #include "Serial.h"
+#include "Shuffle.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include <sys/resource.h>
 
 #include "config.h"
 
@@ -51,6 +65,150 @@ TEST(SerialOBinaryFileConstructorTest, MoveAssignmentTest) {
     EXPECT_EQ(result, 123456789u);
   }
 }
+TEST(SerialOBinaryFileBuffer, flushMakesBytesVisible) {
+  const std::string filename = "test.txt";
+  serial::OBinaryFile file(filename);
+  constexpr uint32_t value = 123456789u;
+  file << value;
+  file.flush();
+
+  serial::IBinaryFile reader(filename);
+  uint32_t result = 0;
+  reader >> result;
+
+  EXPECT_EQ(result, 123456789u);
+}
+TEST(SerialOBinaryFileBuffer, smallBuffer) {
+  const std::string filename = "test.txt";
+  {
+    serial::Options options;
+    options.bufferSize = 3;
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    for (uint32_t i = 0; i < 100; ++i) {
+      file << i << static_cast<uint8_t>(i);
+    }
+  }
+  {
+    serial::IBinaryFile file(filename);
+    for (uint32_t i = 0; i < 100; ++i) {
+      uint32_t a = 0;
+      uint8_t b = 0;
+      file >> a >> b;
+      EXPECT_EQ(a, i);
+      EXPECT_EQ(b, static_cast<uint8_t>(i));
+    }
+  }
+}
+TEST(SerialOBinaryFileBuffer, noBuffer) {
+  const std::string filename = "test.txt";
+  {
+    serial::Options options;
+    options.bufferSize = 0;
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << std::string("unbuffered");
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::string result;
+    file >> result;
+
+    EXPECT_EQ(result, "unbuffered");
+  }
+}
+TEST(SerialOBinaryFileAsync, roundTrip) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.async = true;
+  options.bufferSize = 64;
+  std::vector<uint64_t> values(10000);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = i * 31;
+  }
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    for (uint32_t i = 0; i < 1000; ++i) {
+      file << i;
+    }
+    file << values << std::string(1000, 'z');
+    file.close();
+  }
+  {
+    serial::IBinaryFile file(filename);
+    for (uint32_t i = 0; i < 1000; ++i) {
+      uint32_t value = 0;
+      file >> value;
+      EXPECT_EQ(value, i);
+    }
+    std::vector<uint64_t> result;
+    std::string text;
+    file >> result >> text;
+    EXPECT_EQ(result, values);
+    EXPECT_EQ(text, std::string(1000, 'z'));
+  }
+}
+TEST(SerialOBinaryFileAsync, flushMakesBytesVisible) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.async = true;
+  serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+  file << 123456789u;
+  file.flush();
+
+  serial::IBinaryFile reader(filename);
+  uint32_t result = 0;
+  reader >> result;
+
+  EXPECT_EQ(result, 123456789u);
+}
+TEST(SerialOBinaryFileAsync, errorsAreReported) {
+  serial::Options options;
+  options.async = true;
+  serial::OBinaryFile file("/dev/full", serial::OBinaryFile::Truncate, options);
+  const std::vector<uint8_t> values(1 << 20);
+  EXPECT_THROW({
+    file << values;
+    file.close();
+  }, std::runtime_error);
+}
+TEST(SerialOBinaryFileAsync, errorsStay) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.async = true;
+  options.bufferSize = 64;
+  serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+
+  // the file can not grow past 1 KiB until the limit is lifted, so the
+  // thread fails once
+  rlimit saved;
+  ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &saved), 0);
+  rlimit limit = saved;
+  limit.rlim_cur = 1024;
+  ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limit), 0);
+  const auto handler = std::signal(SIGXFSZ, SIG_IGN);
+  bool failed = false;
+  for (uint64_t i = 0; i < 1000 && !failed; ++i) {
+    try {
+      file << i;
+    } catch (const std::runtime_error&) {
+      failed = true;
+    }
+  }
+  setrlimit(RLIMIT_FSIZE, &saved);
+  std::signal(SIGXFSZ, handler);
+  ASSERT_TRUE(failed);
+
+  // the buffer that was not handed to the thread is kept, and the error is
+  // thrown again although the file can grow now
+  EXPECT_THROW(file << uint64_t(7), std::runtime_error);
+  EXPECT_THROW(file.flush(), std::runtime_error);
+  EXPECT_THROW(file.close(), std::runtime_error);
+}
+TEST(SerialOBinaryFileBuffer, closeReportsErrors) {
+  serial::OBinaryFile file("/dev/full");
+  file << 42u;
+  EXPECT_THROW(file.close(), std::runtime_error);
+  EXPECT_NO_THROW(file.close());
+}
 TEST(SerialOBinaryFileUint16, write) {
   const std::string filename = "test.txt";
   {
@@ -322,6 +480,23 @@ TEST(SerialOBinaryFileString, emptyString) {
   }
 }
 
+TEST(SerialOBinaryFileString, replacesContent) {
+  const std::string filename = "test.txt";
+  const std::string value(100000, 'x');
+  {
+    serial::OBinaryFile file(filename);
+    file << value << std::string("short");
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::string result = "stale";
+    file >> result;
+    EXPECT_EQ(result, value);
+    file >> result;
+    EXPECT_EQ(result, "short");
+  }
+}
+
 TEST(SerialOBinaryFileVector, int16Vector) {
   const std::string filename = "test.txt";
   {
@@ -344,6 +519,79 @@ TEST(SerialOBinaryFileVector, int16Vector) {
     }
   }
 }
+TEST(SerialOBinaryFileVector, largeUint32Vector) {
+  const std::string filename = "test.txt";
+  std::vector<uint32_t> values(100000);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<uint32_t>(i * 2654435761u);
+  }
+  {
+    serial::OBinaryFile file(filename);
+    file << values;
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::vector<uint32_t> result = {42u};
+    file >> result;
+
+    EXPECT_EQ(result, values);
+  }
+}
+TEST(SerialOBinaryFileVector, sameBytesAsElementWise) {
+  const std::vector<int64_t> values = {-1, 0, 1, 123456789012345, -987654321};
+  {
+    serial::OBinaryFile file("test.txt");
+    file << values;
+  }
+  {
+    serial::OBinaryFile file("test2.txt");
+    file << static_cast<uint64_t>(values.size());
+    for (int64_t value : values) {
+      file << value;
+    }
+  }
+  {
+    serial::IBinaryFile bulk("test.txt");
+    serial::IBinaryFile single("test2.txt");
+    for (std::size_t i = 0; i < 8 + values.size() * 8; ++i) {
+      uint8_t a = 0;
+      uint8_t b = 0;
+      bulk >> a;
+      single >> b;
+      EXPECT_EQ(a, b);
+    }
+  }
+}
+TEST(SerialOBinaryFileVector, doubleVector) {
+  const std::string filename = "test.txt";
+  const std::vector<double> values = {0.5, -1.25, 3.141592653589793, 1e300};
+  {
+    serial::OBinaryFile file(filename);
+    file << values;
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::vector<double> result;
+    file >> result;
+
+    EXPECT_EQ(result, values);
+  }
+}
+TEST(SerialOBinaryFileArray, boolArray) {
+  const std::string filename = "test.txt";
+  const std::array<bool, 5> values = {true, false, false, true, true};
+  {
+    serial::OBinaryFile file(filename);
+    file << values;
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::array<bool, 5> result{};
+    file >> result;
+
+    EXPECT_EQ(result, values);
+  }
+}
 TEST(SerialOBinaryFileArray, int16Array) {
   const std::string filename = "test.txt";
   {
@@ -386,6 +634,39 @@ TEST(SerialOBinaryFileMap, intToStringMap) {
     EXPECT_EQ(values[3], "three");
   }
 }
+TEST(SerialOBinaryFileMap, replacesContent) {
+  const std::string filename = "test.txt";
+  std::map<uint64_t, std::string> values;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    values[i * 3] = std::string(i % 17, 'a' + i % 26);
+  }
+  {
+    serial::OBinaryFile file(filename);
+    file << values;
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::map<uint64_t, std::string> result = {{1, "stale"}};
+    file >> result;
+
+    EXPECT_EQ(result, values);
+  }
+}
+TEST(SerialOBinaryFileSet, stringSet) {
+  const std::string filename = "test.txt";
+  const std::set<std::string> values = {"", "a", "abc", "zz"};
+  {
+    serial::OBinaryFile file(filename);
+    file << values;
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::set<std::string> result;
+    file >> result;
+
+    EXPECT_EQ(result, values);
+  }
+}
 TEST(SerialOBinaryFileSet, intSet) {
   const std::string filename = "test.txt";
   {
@@ -406,6 +687,254 @@ TEST(SerialOBinaryFileSet, intSet) {
     EXPECT_TRUE(values.count(8) == 1);
   }
 }
+TEST(SerialOBinaryFileUnordered, mapAndSet) {
+  const std::string filename = "test.txt";
+  std::unordered_map<uint64_t, std::string> map;
+  std::unordered_set<std::string> set;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    map[i * 3] = std::string(i % 17, 'a' + i % 26);
+    set.insert(std::to_string(i * 7));
+  }
+  {
+    serial::OBinaryFile file(filename);
+    file << map << set;
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::unordered_map<uint64_t, std::string> map2 = {{1, "stale"}};
+    std::unordered_set<std::string> set2;
+    file >> map2 >> set2;
+
+    EXPECT_EQ(map2, map);
+    EXPECT_EQ(set2, set);
+    // the buckets were allocated before the insertions, growing them
+    // one insertion at a time ends with another count
+    std::unordered_map<uint64_t, std::string> reserved;
+    reserved.reserve(map.size());
+    EXPECT_EQ(map2.bucket_count(), reserved.bucket_count());
+    std::unordered_set<std::string> reservedSet;
+    reservedSet.reserve(set.size());
+    EXPECT_EQ(set2.bucket_count(), reservedSet.bucket_count());
+  }
+}
+TEST(SerialOBinaryFileUnordered, sameAsOrdered) {
+  const std::string filename = "test.txt";
+  const std::map<int32_t, std::string> values = {{1, "one"}, {2, "two"}, {3, "three"}};
+  {
+    serial::OBinaryFile file(filename);
+    file << values;
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::unordered_map<int32_t, std::string> result;
+    file >> result;
+
+    const std::unordered_map<int32_t, std::string> expected(values.begin(), values.end());
+    EXPECT_EQ(result, expected);
+  }
+}
+TEST(SerialOBinaryFileUnordered, bucketCount) {
+  const std::string filename = "test.txt";
+  std::unordered_set<uint32_t> values;
+  values.rehash(5000);
+  for (uint32_t i = 0; i < 100; ++i) {
+    values.insert(i);
+  }
+  {
+    serial::OBinaryFile file(filename);
+    file << serial::buckets(values);
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::unordered_set<uint32_t> result;
+    file >> serial::buckets(result);
+
+    EXPECT_EQ(result, values);
+    EXPECT_GE(result.bucket_count(), values.bucket_count());
+  }
+}
+TEST(SerialFlat, stringsAndLists) {
+  const std::string filename = "test.txt";
+  std::vector<std::string> strings;
+  std::vector<std::vector<uint32_t>> lists;
+  for (std::size_t i = 0; i < 1000; i++) {
+    strings.push_back(std::string(i % 13, static_cast<char>('a' + i % 26)));
+    lists.push_back(std::vector<uint32_t>(i % 7, static_cast<uint32_t>(i)));
+  }
+  {
+    serial::OBinaryFile file(filename);
+    file << serial::flat(strings) << serial::flat(lists);
+  }
+
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    serial::IBinaryFile file(filename, mode);
+    std::vector<std::string> strings2 = { "stale" };
+    std::vector<std::vector<uint32_t>> lists2;
+    file >> serial::flat(strings2) >> serial::flat(lists2);
+    EXPECT_EQ(strings2, strings);
+    EXPECT_EQ(lists2, lists);
+  }
+}
+TEST(SerialFlat, stringsView) {
+  const std::string filename = "test.txt";
+  const std::vector<std::string> strings = { "the", "", "quick", "brown", "fox" };
+  {
+    serial::OBinaryFile file(filename);
+    file << serial::flat(strings) << uint8_t(7);
+  }
+
+  // the header is the size, then the offsets, then the characters
+  EXPECT_EQ(std::ifstream(filename, std::ios::binary | std::ios::ate).tellg(), 8 + 8 * 5 + 16 + 1);
+
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    serial::IBinaryFile file(filename, mode);
+    serial::StringsView view;
+    uint8_t end;
+    file >> view >> end;
+    ASSERT_EQ(view.size(), strings.size());
+    for (std::size_t i = 0; i < strings.size(); i++) {
+      EXPECT_EQ(view[i], strings[i]);
+    }
+    EXPECT_EQ(end, 7u);
+  }
+}
+TEST(SerialFlat, corruptedOffsets) {
+  const std::string filename = "test.txt";
+  {
+    serial::OBinaryFile file(filename);
+    file << uint64_t(2) << uint64_t(5) << uint64_t(3) << std::string("abcde");
+  }
+  serial::IBinaryFile file(filename);
+  std::vector<std::string> strings;
+  EXPECT_THROW(file >> serial::flat(strings), std::runtime_error);
+}
+TEST(SerialPacked, kernels) {
+  std::mt19937_64 rng(42);
+  for (unsigned width = 0; width <= 64; width++) {
+    for (std::size_t count : {0, 1, 5, 8, 127, 128}) {
+      std::vector<uint64_t> values(count);
+      for (auto& value : values) {
+        value = width == 64 ? rng() : rng() & ((uint64_t(1) << width) - 1);
+      }
+      std::vector<std::byte> packed(count * 8 + 8);
+      EXPECT_EQ(serial::packBits(values.data(), count, width, packed.data()), (count * width + 7) / 8);
+
+      std::vector<uint64_t> unpacked(count), scalar(count);
+      serial::unpackBits(packed.data(), count, width, unpacked.data());
+      serial::detail::unpackBitsScalar(packed.data(), count, width, scalar.data());
+      EXPECT_EQ(unpacked, values);
+      EXPECT_EQ(scalar, values);
+
+      const uint64_t last = serial::addGaps(unpacked.data(), count, width);
+      const uint64_t lastScalar = serial::detail::addGapsScalar(scalar.data(), count, width);
+      EXPECT_EQ(unpacked, scalar);
+      EXPECT_EQ(last, lastScalar);
+    }
+  }
+}
+TEST(SerialPacked, setsAndMaps) {
+  const std::string filename = "test.txt";
+  std::set<uint64_t> dense;
+  for (uint64_t i = 0; i < 1000; i++) {
+    dense.insert(1000000 + i);
+  }
+  const std::set<int32_t> signedKeys = { INT32_MIN, -5, 0, 3, 1 << 20, INT32_MAX };
+  const std::set<uint64_t> extremes = { 0, 1, UINT64_MAX - 1, UINT64_MAX };
+  std::map<int64_t, std::string> map;
+  for (int64_t i = -300; i < 300; i += 3) {
+    map[i * i * i] = std::to_string(i);
+  }
+  {
+    serial::OBinaryFile file(filename);
+    file << serial::packed(dense) << serial::packed(signedKeys) << serial::packed(extremes) << serial::packed(map);
+    const std::set<uint8_t> empty;
+    file << serial::packed(empty);
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::set<uint64_t> dense2 = { 7 };
+    std::set<int32_t> signedKeys2;
+    std::set<uint64_t> extremes2;
+    std::map<int64_t, std::string> map2;
+    std::set<uint8_t> empty;
+    file >> serial::packed(dense2) >> serial::packed(signedKeys2) >> serial::packed(extremes2) >> serial::packed(map2) >> serial::packed(empty);
+    EXPECT_EQ(dense2, dense);
+    EXPECT_EQ(signedKeys2, signedKeys);
+    EXPECT_EQ(extremes2, extremes);
+    EXPECT_EQ(map2, map);
+    EXPECT_TRUE(empty.empty());
+  }
+}
+TEST(SerialPacked, denseRangeSize) {
+  const std::string filename = "test.txt";
+  std::set<uint64_t> ids;
+  for (uint64_t i = 0; i < 1280; i++) {
+    ids.insert((uint64_t(1) << 40) + i);
+  }
+  {
+    serial::OBinaryFile file(filename);
+    file << serial::packed(ids);
+  }
+
+  // the size and the first key, then a width of 0 for each block
+  EXPECT_EQ(std::ifstream(filename, std::ios::binary | std::ios::ate).tellg(), 8 + 8 + 10);
+}
+TEST(SerialFloats, kernels) {
+  std::mt19937_64 rng(42);
+  for (std::size_t width : {4, 8}) {
+    for (std::size_t count : {0, 1, 15, 16, 17, 100}) {
+      std::vector<std::byte> values(count * width);
+      for (auto& b : values) {
+        b = static_cast<std::byte>(rng());
+      }
+      for (bool xorDelta : {false, true}) {
+        std::vector<std::byte> planes(values.size()), back(values.size()), scalar(values.size());
+        serial::shuffleBytes(planes.data(), values.data(), count, width, xorDelta);
+        serial::unshuffleBytes(back.data(), planes.data(), count, width, xorDelta);
+        serial::detail::unshuffleBytesScalar(scalar.data(), planes.data(), count, width, xorDelta);
+        EXPECT_EQ(back, values);
+        EXPECT_EQ(scalar, values);
+      }
+    }
+  }
+}
+TEST(SerialFloats, roundTrip) {
+  const std::string filename = "test.txt";
+  // a slowly changing series, with the values that must survive bit for bit
+  std::vector<double> series(200000);
+  for (std::size_t i = 0; i < series.size(); i++) {
+    series[i] = 20.0 + static_cast<double>(i / 100) * 0.25;
+  }
+  series[10] = -0.0;
+  series[11] = std::numeric_limits<double>::quiet_NaN();
+  series[12] = std::numeric_limits<double>::infinity();
+  series[13] = std::numeric_limits<double>::denorm_min();
+  const std::array<float, 5> array = { 1.5f, -2.25f, 0.0f, 3e38f, 1e-40f };
+
+  for (auto codec : { serial::FloatCodec::Shuffle, serial::FloatCodec::Xor }) {
+    {
+      serial::OBinaryFile file(filename);
+      file << serial::floats(series, codec) << serial::floats(array, codec) << uint8_t(7);
+    }
+    EXPECT_LT(std::ifstream(filename, std::ios::binary | std::ios::ate).tellg(), static_cast<std::streamoff>(series.size() * 8 / 4));
+
+    for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+      serial::IBinaryFile file(filename, mode);
+      std::vector<double> series2;
+      std::array<float, 5> array2;
+      uint8_t end;
+      file >> serial::floats(series2) >> serial::floats(array2) >> end;
+      ASSERT_EQ(series2.size(), series.size());
+      EXPECT_EQ(std::memcmp(series2.data(), series.data(), series.size() * sizeof(double)), 0);
+      EXPECT_EQ(std::memcmp(array2.data(), array.data(), sizeof(array)), 0);
+      EXPECT_EQ(end, 7u);
+    }
+  }
+
+  serial::IBinaryFile file(filename);
+  std::array<double, 3> wrongSize;
+  EXPECT_THROW(file >> serial::floats(wrongSize), std::runtime_error);
+}
 
 
 
@@ -604,6 +1133,1391 @@ TEST(SerialIBinaryFileOperatorTest,vectorOperator2) {
   }
 }
 
+TEST(SerialIBinaryFileMapped, primitivesAndContainers) {
+  const std::string filename = "test.txt";
+  const std::vector<int32_t> v = {1, 2, -1, -7647, 5654653};
+  const std::map<int, std::string> m = {{1, "one"}, {2, "two"}};
+  {
+    serial::OBinaryFile file(filename);
+    file << static_cast<uint16_t>(65535u) << 0.25 << std::string("mapped") << v << m;
+  }
+  {
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Mapped);
+    EXPECT_TRUE(file.mapped());
+
+    uint16_t a = 0;
+    double b = 0;
+    std::string c;
+    std::vector<int32_t> d;
+    std::map<int, std::string> e;
+    file >> a >> b >> c >> d >> e;
+
+    EXPECT_EQ(a, 65535u);
+    EXPECT_EQ(b, 0.25);
+    EXPECT_EQ(c, "mapped");
+    EXPECT_EQ(d, v);
+    EXPECT_EQ(e.size(), 2);
+
+    uint8_t past = 0;
+    EXPECT_THROW(file >> past, std::runtime_error);
+  }
+}
+TEST(SerialIBinaryFileMapped, views) {
+  const std::string filename = "test.txt";
+  const std::vector<char> bytes = {'a', 'b', 'c'};
+  {
+    serial::OBinaryFile file(filename);
+    file << std::string("hello world") << bytes;
+  }
+  {
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Mapped);
+    std::string_view text;
+    serial::Span<char> span;
+    file >> text >> span;
+
+    EXPECT_EQ(text, "hello world");
+    EXPECT_EQ(std::vector<char>(span.begin(), span.end()), bytes);
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::string_view text;
+    EXPECT_THROW(file >> text, std::runtime_error);
+  }
+}
+TEST(SerialIBinaryFileMapped, emptyFile) {
+  const std::string filename = "test.txt";
+  {
+    serial::OBinaryFile file(filename);
+  }
+  {
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Mapped);
+    uint8_t value = 0;
+    EXPECT_THROW(file >> value, std::runtime_error);
+  }
+}
+TEST(SerialIBinaryFileBuffer, smallBuffer) {
+  const std::string filename = "test.txt";
+  std::vector<uint64_t> values(1000);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = i * i;
+  }
+  {
+    serial::OBinaryFile file(filename);
+    file << values << static_cast<uint32_t>(7u);
+  }
+  {
+    serial::Options options;
+    options.bufferSize = 5;
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+    std::vector<uint64_t> result;
+    uint32_t last = 0;
+    file >> result >> last;
+
+    EXPECT_EQ(result, values);
+    EXPECT_EQ(last, 7u);
+  }
+}
+
+TEST(SerialVectorRange, streamsElements) {
+  const std::string filename = "test.txt";
+  std::vector<uint32_t> values(10000);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<uint32_t>(i * 7);
+  }
+  {
+    serial::OBinaryFile file(filename);
+    file << values << std::string("after");
+  }
+  {
+    serial::IBinaryFile file(filename);
+    serial::VectorRange<uint32_t> range(file, 100);
+    EXPECT_EQ(range.size(), values.size());
+
+    std::size_t i = 0;
+    for (uint32_t value : range) {
+      ASSERT_LT(i, values.size());
+      EXPECT_EQ(value, values[i]);
+      ++i;
+    }
+    EXPECT_EQ(i, values.size());
+
+    std::string after;
+    file >> after;
+    EXPECT_EQ(after, "after");
+  }
+}
+TEST(SerialVectorRange, emptyAndNested) {
+  const std::string filename = "test.txt";
+  const std::vector<std::string> strings = {"a", "bc", "def"};
+  {
+    serial::OBinaryFile file(filename);
+    file << std::vector<double>() << strings;
+  }
+  {
+    serial::IBinaryFile file(filename);
+    serial::VectorRange<double> empty(file);
+    EXPECT_TRUE(empty.begin() == empty.end());
+
+    serial::VectorRange<std::string> range(file, 2);
+    std::vector<std::string> result(range.begin(), range.end());
+    EXPECT_EQ(result, strings);
+  }
+}
+
+namespace {
+  using SwapKernel = void (*)(std::byte* dst, const std::byte* src, std::size_t count);
+
+  struct SwapKernels {
+    SwapKernel swap16;
+    SwapKernel swap32;
+    SwapKernel swap64;
+  };
+}
+
+TEST(SerialByteSwap, allWidths) {
+  std::vector<SwapKernels> kernels = {
+    { serial::byteSwap16, serial::byteSwap32, serial::byteSwap64 },
+    { serial::detail::byteSwap16Scalar, serial::detail::byteSwap32Scalar, serial::detail::byteSwap64Scalar },
+  };
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("sse2")) {
+    kernels.push_back({ serial::detail::byteSwap16Sse2, serial::detail::byteSwap32Sse2, serial::detail::byteSwap64Sse2 });
+  }
+#endif
+
+  for (const auto& kernel : kernels) {
+    for (std::size_t count = 0; count < 70; ++count) {
+      std::vector<uint16_t> a(count);
+      std::vector<uint32_t> b(count);
+      std::vector<uint64_t> c(count);
+      for (std::size_t i = 0; i < count; ++i) {
+        a[i] = static_cast<uint16_t>(0x0102 + i);
+        b[i] = static_cast<uint32_t>(0x01020304 + i);
+        c[i] = 0x0102030405060708 + i;
+      }
+
+      std::vector<uint16_t> a2(count);
+      std::vector<uint32_t> b2(count);
+      std::vector<uint64_t> c2 = c;
+      kernel.swap16(reinterpret_cast<std::byte*>(a2.data()), reinterpret_cast<const std::byte*>(a.data()), count);
+      kernel.swap32(reinterpret_cast<std::byte*>(b2.data()), reinterpret_cast<const std::byte*>(b.data()), count);
+      kernel.swap64(reinterpret_cast<std::byte*>(c2.data()), reinterpret_cast<const std::byte*>(c2.data()), count);
+
+      for (std::size_t i = 0; i < count; ++i) {
+        EXPECT_EQ(a2[i], __builtin_bswap16(a[i]));
+        EXPECT_EQ(b2[i], __builtin_bswap32(b[i]));
+        EXPECT_EQ(c2[i], __builtin_bswap64(c[i]));
+      }
+    }
+  }
+}
+
+TEST(SerialCompactEncoding, integers) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.encoding = serial::Encoding::Compact;
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << static_cast<uint16_t>(300) << static_cast<int16_t>(-2) << static_cast<uint32_t>(127)
+      << static_cast<int32_t>(-2147483647 - 1) << UINT64_MAX << INT64_MIN << static_cast<int64_t>(5);
+  }
+  {
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+    uint16_t a = 0;
+    int16_t b = 0;
+    uint32_t c = 0;
+    int32_t d = 0;
+    uint64_t e = 0;
+    int64_t f = 0;
+    int64_t g = 0;
+    file >> a >> b >> c >> d >> e >> f >> g;
+
+    EXPECT_EQ(a, 300);
+    EXPECT_EQ(b, -2);
+    EXPECT_EQ(c, 127u);
+    EXPECT_EQ(d, -2147483647 - 1);
+    EXPECT_EQ(e, UINT64_MAX);
+    EXPECT_EQ(f, INT64_MIN);
+    EXPECT_EQ(g, 5);
+  }
+}
+TEST(SerialCompactEncoding, smallerFile) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.encoding = serial::Encoding::Compact;
+  const std::vector<std::vector<uint8_t>> strings(100, {1, 2, 3});
+  std::vector<int64_t> counters(1000);
+  for (std::size_t i = 0; i < counters.size(); ++i) {
+    counters[i] = static_cast<int64_t>(i % 200) - 100;
+  }
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << strings << counters;
+  }
+  {
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Mapped, options);
+    std::vector<std::vector<uint8_t>> a;
+    std::vector<int64_t> b;
+    file >> a >> b;
+
+    EXPECT_EQ(a, strings);
+    EXPECT_EQ(b, counters);
+
+    uint8_t past = 0;
+    EXPECT_THROW(file >> past, std::runtime_error);
+  }
+  {
+    // 1 byte per size and 1 or 2 bytes per counter
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    std::fseek(file, 0, SEEK_END);
+    EXPECT_LT(std::ftell(file), 1 + 100 * 4 + 2 + 2000);
+    std::fclose(file);
+  }
+}
+TEST(SerialCompactEncoding, outOfRange) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.encoding = serial::Encoding::Compact;
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << static_cast<uint32_t>(70000);
+  }
+  {
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+    uint16_t value = 0;
+    EXPECT_THROW(file >> value, std::runtime_error);
+  }
+}
+
+TEST(SerialCompression, lzRoundTrip) {
+  std::mt19937 rng(42);
+  for (std::size_t size : {0, 1, 5, 100, 70000}) {
+    std::vector<std::byte> data(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      // a mix of runs, repeated text and noise
+      data[i] = static_cast<std::byte>(i % 3 == 0 ? rng() % 4 : (i / 100) % 7);
+    }
+    std::vector<std::byte> compressed(size + 64);
+    const std::size_t n = serial::detail::lzCompress(data.data(), size, compressed.data(), compressed.size());
+    ASSERT_GT(n, 0u);
+
+    std::vector<std::byte> result(size);
+    EXPECT_TRUE(serial::detail::lzDecompress(compressed.data(), n, result.data(), size));
+    EXPECT_EQ(result, data);
+
+    std::vector<std::byte> larger(size + 1);
+    EXPECT_FALSE(serial::detail::lzDecompress(compressed.data(), n, larger.data(), size + 1));
+  }
+}
+TEST(SerialCompression, roundTrip) {
+  const std::string filename = "test.txt";
+  std::map<uint64_t, std::string> values;
+  for (uint64_t i = 0; i < 5000; ++i) {
+    values[i] = "key-" + std::to_string(i % 10);
+  }
+
+  for (bool async : {false, true}) {
+    serial::Options options;
+    options.compression = serial::Compression::Lz;
+    options.bufferSize = 4096;
+    options.async = async;
+    {
+      serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+      file << values << 3.5;
+    }
+    for (auto mode : {serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped}) {
+      serial::IBinaryFile file(filename, mode, options);
+      std::map<uint64_t, std::string> result;
+      double last = 0;
+      file >> result >> last;
+
+      EXPECT_EQ(result, values);
+      EXPECT_EQ(last, 3.5);
+
+      uint8_t past = 0;
+      EXPECT_THROW(file >> past, std::runtime_error);
+    }
+  }
+
+  FILE* file = std::fopen(filename.c_str(), "rb");
+  std::fseek(file, 0, SEEK_END);
+  EXPECT_LT(std::ftell(file), 5000 * 8);
+  std::fclose(file);
+}
+TEST(SerialCompression, noViews) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.compression = serial::Compression::Lz;
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << std::string("text");
+  }
+  {
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Mapped, options);
+    std::string_view text;
+    EXPECT_THROW(file >> text, std::runtime_error);
+  }
+}
+TEST(SerialCompression, unavailableCodec) {
+  serial::Options options;
+  options.compression = serial::Compression::Zstd;
+  if (serial::detail::compressionAvailable(serial::Compression::Zstd)) {
+    EXPECT_NO_THROW(serial::OBinaryFile("test.txt", serial::OBinaryFile::Truncate, options));
+  } else {
+    EXPECT_THROW(serial::OBinaryFile("test.txt", serial::OBinaryFile::Truncate, options), std::runtime_error);
+  }
+}
+TEST(SerialChecksum, crc32c) {
+  const std::string text = "123456789";
+  const auto* bytes = reinterpret_cast<const std::byte*>(text.data());
+  EXPECT_EQ(serial::crc32c(0, bytes, text.size()), 0xE3069283u);
+  EXPECT_EQ(serial::detail::crc32cScalar(0, bytes, text.size()), 0xE3069283u);
+  EXPECT_EQ(serial::crc32c(serial::crc32c(0, bytes, 4), bytes + 4, 5), 0xE3069283u);
+
+  std::mt19937 rng(42);
+  std::vector<std::byte> data(1000);
+  for (auto& b : data) {
+    b = static_cast<std::byte>(rng());
+  }
+  for (std::size_t size : {0, 1, 7, 8, 13, 1000}) {
+    EXPECT_EQ(serial::crc32c(0, data.data(), size), serial::detail::crc32cScalar(0, data.data(), size));
+  }
+}
+TEST(SerialChecksum, roundTrip) {
+  const std::string filename = "test.txt";
+  std::vector<uint32_t> values(20000);
+  for (std::size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<uint32_t>(i % 100);
+  }
+
+  for (auto compression : { serial::Compression::None, serial::Compression::Lz }) {
+    for (bool async : { false, true }) {
+      serial::Options options;
+      options.checksum = true;
+      options.compression = compression;
+      options.async = async;
+      options.bufferSize = 4096;
+      {
+        serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+        file << values << std::string("end");
+      }
+      for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+        serial::IBinaryFile file(filename, mode, options);
+        std::vector<uint32_t> values2;
+        std::string end;
+        file >> values2 >> end;
+        EXPECT_EQ(values2, values);
+        EXPECT_EQ(end, "end");
+      }
+    }
+  }
+}
+TEST(SerialChecksum, corruptionIsDetected) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.checksum = true;
+  options.header = true;
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << std::vector<uint64_t>(100, 7);
+  }
+  {
+    // in the payload of the first block, after the file and block headers
+    std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(16 + 13 + 20);
+    file.put(char(1));
+  }
+
+  serial::Options readOptions;
+  readOptions.header = true;
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    serial::IBinaryFile file(filename, mode, readOptions);
+    EXPECT_TRUE(file.checksum());
+    std::vector<uint64_t> values;
+    EXPECT_THROW(file >> values, std::runtime_error);
+  }
+
+  // the check can be skipped, the bytes are then read as they are
+  readOptions.verify = false;
+  serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, readOptions);
+  std::vector<uint64_t> values;
+  file >> values;
+  EXPECT_EQ(values.size(), 100u);
+}
+TEST(SerialChecksum, blocksWithoutChecksum) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.compression = serial::Compression::Lz;
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << uint64_t(42);
+  }
+  options.checksum = true;
+  serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+  uint64_t x;
+  EXPECT_THROW(file >> x, std::runtime_error);
+}
+TEST(SerialSections, seekAnySection) {
+  const std::string filename = "test.txt";
+  const std::vector<uint32_t> users = { 1, 2, 3, 4 };
+  const std::map<std::string, uint64_t> index = { { "a", 1 }, { "b", 2 } };
+  {
+    serial::OBinaryFile file(filename);
+    file.beginSection("users");
+    file << users;
+    file.beginSection("index");
+    file << index;
+    file.endSection();
+  }
+
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    serial::IBinaryFile file(filename, mode);
+    ASSERT_EQ(file.sections().size(), 2u);
+    EXPECT_EQ(file.sections()[0].name, "users");
+    EXPECT_EQ(file.sections()[0].offset, 0u);
+    EXPECT_EQ(file.sections()[0].length, 8u + 4u * 4u);
+    EXPECT_TRUE(file.hasSection("index"));
+    EXPECT_FALSE(file.hasSection("other"));
+
+    std::map<std::string, uint64_t> index2;
+    file.seekSection("index");
+    file >> index2;
+    EXPECT_EQ(index, index2);
+
+    std::vector<uint32_t> users2;
+    file.seekSection("users");
+    file >> users2;
+    EXPECT_EQ(users, users2);
+
+    EXPECT_THROW(file.seekSection("other"), std::runtime_error);
+  }
+}
+TEST(SerialSections, compressedAndAsync) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.compression = serial::Compression::Lz;
+  options.async = true;
+  std::vector<uint64_t> first(10000), second(10000);
+  for (std::size_t i = 0; i < first.size(); i++) {
+    first[i] = i;
+    second[i] = i * i;
+  }
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file.beginSection("first");
+    file << first;
+    file.beginSection("second");
+    file << second;
+  }
+
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    serial::IBinaryFile file(filename, mode, options);
+    std::vector<uint64_t> values;
+    file.seekSection("second");
+    file >> values;
+    EXPECT_EQ(second, values);
+    file.seekSection("first");
+    file >> values;
+    EXPECT_EQ(first, values);
+  }
+}
+TEST(SerialSections, readsStopAtTheEnd) {
+  const std::string filename = "test.txt";
+  for (auto compression : { serial::Compression::None, serial::Compression::Lz }) {
+    serial::Options options;
+    options.compression = compression;
+    {
+      serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+      file.beginSection("first");
+      file << uint32_t(1) << uint32_t(2);
+      file.beginSection("second");
+      file << uint32_t(3) << uint32_t(4);
+    }
+
+    for (int reader = 0; reader < 3; reader++) {
+      // plain, with a read-ahead, or with direct I/O for the raw file
+      options.readAhead = reader == 1 ? 2 : 0;
+      options.direct = reader == 2;
+      if (options.direct && compression != serial::Compression::None) {
+        continue;
+      }
+      for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+        serial::IBinaryFile file(filename, mode, options);
+        uint32_t a, b;
+        file.seekSection("first");
+        file >> a >> b;
+        EXPECT_EQ(b, 2u);
+        EXPECT_THROW(file >> a, std::runtime_error);
+
+        // the table of contents follows the last section
+        file.seekSection("second");
+        file >> a >> b;
+        EXPECT_EQ(b, 4u);
+        EXPECT_THROW(file >> a, std::runtime_error);
+
+        file.seekSection("second");
+        EXPECT_THROW(file.skip(9), std::runtime_error);
+      }
+    }
+  }
+}
+TEST(SerialSections, duplicateName) {
+  serial::OBinaryFile file("test.txt");
+  file.beginSection("a");
+  EXPECT_THROW(file.beginSection("a"), std::runtime_error);
+}
+TEST(SerialSections, noSections) {
+  const std::string filename = "test.txt";
+  {
+    serial::OBinaryFile file(filename);
+    file << uint64_t(42);
+  }
+  serial::IBinaryFile file(filename);
+  EXPECT_TRUE(file.sections().empty());
+  uint64_t x;
+  file >> x;
+  EXPECT_EQ(x, 42u);
+}
+TEST(SerialDirect, roundTrip) {
+  const std::string filename = "test.txt";
+  std::vector<uint16_t> values(7001);
+  for (std::size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<uint16_t>(i * 31);
+  }
+
+  serial::Options options;
+  options.direct = true;
+  options.bufferSize = 5000;
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << std::string("head");
+    // the tail of an unaligned flush stays in the buffer
+    file.flush();
+    file << values;
+  }
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Append, options);
+    file << uint8_t(42) << values;
+  }
+
+  serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+  std::string head;
+  std::vector<uint16_t> values2;
+  uint8_t byte;
+  file >> head >> values2 >> byte;
+  file.skip(8 + 2 * 1000);
+  uint16_t value;
+  file >> value;
+  EXPECT_EQ(head, "head");
+  EXPECT_EQ(values2, values);
+  EXPECT_EQ(byte, 42u);
+  EXPECT_EQ(value, values[1000]);
+}
+TEST(SerialDirect, sections) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.direct = true;
+  options.dropCache = true;
+  options.preallocate = 1 << 20;
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file.beginSection("first");
+    file << std::vector<uint64_t>(1000, 1);
+    file.beginSection("second");
+    file << std::string("second");
+    file.endSection();
+  }
+
+  // the preallocated space does not stay at the end of the file
+  std::ifstream raw(filename, std::ios::binary | std::ios::ate);
+  EXPECT_LT(static_cast<uint64_t>(raw.tellg()), uint64_t(1) << 20);
+
+  for (bool direct : { true, false }) {
+    options.direct = direct;
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+    std::string second;
+    std::vector<uint64_t> first;
+    file.seekSection("second");
+    file >> second;
+    file.seekSection("first");
+    file >> first;
+    EXPECT_EQ(second, "second");
+    EXPECT_EQ(first, std::vector<uint64_t>(1000, 1));
+  }
+}
+TEST(SerialDirect, needsRawBlocks) {
+  serial::Options options;
+  options.direct = true;
+  options.compression = serial::Compression::Lz;
+  EXPECT_THROW(serial::OBinaryFile("test.txt", serial::OBinaryFile::Truncate, options), std::runtime_error);
+  options.compression = serial::Compression::None;
+  options.async = true;
+  EXPECT_THROW(serial::OBinaryFile("test.txt", serial::OBinaryFile::Truncate, options), std::runtime_error);
+}
+TEST(SerialReadAhead, roundTrip) {
+  const std::string filename = "test.txt";
+  std::vector<uint32_t> values(50000);
+  for (std::size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<uint32_t>(i * 7 % 1000);
+  }
+
+  for (auto compression : { serial::Compression::None, serial::Compression::Lz }) {
+    serial::Options options;
+    options.compression = compression;
+    options.header = true;
+    options.bufferSize = 4096;
+    {
+      serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+      file << std::string("start") << values;
+      for (uint32_t i = 0; i < 1000; i++) {
+        file << i;
+      }
+      file << values;
+    }
+
+    options.readAhead = 3;
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+    std::string start;
+    std::vector<uint32_t> values2;
+    file >> start >> values2;
+    EXPECT_EQ(start, "start");
+    EXPECT_EQ(values2, values);
+
+    file.skip(4 * 500);
+    uint32_t value;
+    file >> value;
+    EXPECT_EQ(value, 500u);
+    file.skip(4 * 499);
+
+    std::vector<uint32_t> values3;
+    file >> values3;
+    EXPECT_EQ(values3, values);
+    EXPECT_THROW(file >> value, std::runtime_error);
+  }
+}
+TEST(SerialReadAhead, skipKeepsLoadedChunks) {
+  const std::string filename = "test.txt";
+  const std::vector<uint32_t> values(16 * 1024, 5);
+  {
+    serial::OBinaryFile file(filename);
+    file << values;
+  }
+
+  serial::Options options;
+  options.bufferSize = 4096;
+  options.readAhead = 4;
+  serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+  uint64_t size;
+  file >> size;
+
+  // let the chunks ahead be loaded, then skip into the third one
+  for (int i = 0; i < 1000 && file.stats().ioBytes < 5 * 4096; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  file.skip(2 * 4096);
+  uint32_t value;
+  for (std::size_t i = 2 * 1024; i < values.size(); i++) {
+    file >> value;
+    EXPECT_EQ(value, 5u);
+  }
+  EXPECT_THROW(file >> value, std::runtime_error);
+
+  // each byte was read once
+  EXPECT_EQ(file.stats().ioBytes, 8 + 4 * values.size());
+}
+TEST(SerialReadAhead, sectionsAndDirect) {
+  const std::string filename = "test.txt";
+  const std::vector<uint64_t> first(3000, 1);
+  const std::vector<uint64_t> second(5000, 2);
+  {
+    serial::OBinaryFile file(filename);
+    file.beginSection("first");
+    file << first;
+    file.beginSection("second");
+    file << second;
+    file.endSection();
+  }
+
+  for (bool direct : { false, true }) {
+    serial::Options options;
+    options.readAhead = 2;
+    options.bufferSize = 6000;
+    options.direct = direct;
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+    std::vector<uint64_t> values;
+    file.seekSection("second");
+    file >> values;
+    EXPECT_EQ(values, second);
+    file.seekSection("first");
+    file >> values;
+    EXPECT_EQ(values, first);
+
+    // the reads were made by the read-ahead
+    const serial::Stats stats = file.stats();
+    EXPECT_GT(stats.ioCalls, 0u);
+    EXPECT_GE(stats.ioBytes, 8u * (3000 + 5000));
+  }
+}
+namespace {
+  struct Vec3 {
+    float x;
+    float y;
+    float z;
+    SERIAL_FIELDS(x, y, z)
+  };
+
+  struct Swapped {
+    float a;
+    float b;
+    SERIAL_FIELDS(b, a)
+  };
+
+  struct Person {
+    std::string name;
+    int32_t age;
+    std::vector<Vec3> path;
+    SERIAL_FIELDS(name, age, path)
+  };
+}
+
+TEST(SerialReflection, traits) {
+  EXPECT_TRUE(serial::detail::is_reflected_v<Vec3>);
+  EXPECT_FALSE(serial::detail::is_reflected_v<std::string>);
+  EXPECT_TRUE(serial::detail::is_raw_v<Vec3>);
+  EXPECT_TRUE(serial::detail::is_raw_v<Swapped>);
+  EXPECT_FALSE(serial::detail::is_raw_v<Person>);
+  EXPECT_TRUE(serial::detail::isRawCopy(serial::Encoding::Fixed, Vec3{}));
+  EXPECT_FALSE(serial::detail::isRawCopy(serial::Encoding::Fixed, Swapped{}));
+}
+namespace {
+  struct Point {
+    int32_t x;
+    int32_t y;
+    SERIAL_FIELDS(x, y)
+  };
+}
+TEST(SerialHeader, nativeIsMemory) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.encoding = serial::Encoding::Native;
+  const std::vector<uint64_t> values = { 1, 0x0102030405060708, UINT64_MAX };
+  const std::vector<Point> points = { { 1, -2 }, { -3, 4 } };
+  EXPECT_TRUE(serial::detail::is_native_v<Point>);
+  EXPECT_TRUE(serial::detail::isRawCopy(options.encoding, points[0]));
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << uint32_t(0x01020304) << values << points;
+  }
+
+  std::vector<std::byte> expected(sizeof(uint32_t) + 2 * sizeof(uint64_t) + values.size() * sizeof(uint64_t) + points.size() * sizeof(Point));
+  const uint32_t first = 0x01020304;
+  const uint64_t sizes[2] = { values.size(), points.size() };
+  std::byte* p = expected.data();
+  std::memcpy(p, &first, sizeof(first)); p += sizeof(first);
+  std::memcpy(p, &sizes[0], 8); p += 8;
+  std::memcpy(p, values.data(), values.size() * sizeof(uint64_t)); p += values.size() * sizeof(uint64_t);
+  std::memcpy(p, &sizes[1], 8); p += 8;
+  std::memcpy(p, points.data(), points.size() * sizeof(Point));
+
+  serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+  std::vector<std::byte> bytes(expected.size());
+  file.read(bytes.data(), bytes.size());
+  EXPECT_EQ(bytes, expected);
+
+  serial::IBinaryFile file2(filename, serial::IBinaryFile::Mapped, options);
+  uint32_t first2;
+  std::vector<uint64_t> values2;
+  std::vector<Point> points2;
+  file2 >> first2 >> values2 >> points2;
+  EXPECT_EQ(first2, first);
+  EXPECT_EQ(values2, values);
+  ASSERT_EQ(points2.size(), points.size());
+  EXPECT_EQ(points2[1].x, -3);
+  EXPECT_EQ(points2[1].y, 4);
+}
+TEST(SerialHeader, settingsComeFromTheHeader) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.header = true;
+  options.encoding = serial::Encoding::Compact;
+  options.compression = serial::Compression::Lz;
+  const std::vector<int64_t> values(1000, -5);
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << values << std::string("end");
+  }
+
+  serial::Options readOptions;
+  readOptions.header = true;
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    serial::IBinaryFile file(filename, mode, readOptions);
+    EXPECT_EQ(file.encoding(), serial::Encoding::Compact);
+    EXPECT_EQ(file.compression(), serial::Compression::Lz);
+    std::vector<int64_t> values2;
+    std::string end;
+    file >> values2 >> end;
+    EXPECT_EQ(values2, values);
+    EXPECT_EQ(end, "end");
+  }
+}
+TEST(SerialHeader, badHeaders) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.header = true;
+  {
+    serial::OBinaryFile file(filename);
+    file << uint64_t(42) << uint64_t(42);
+  }
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    EXPECT_THROW(serial::IBinaryFile(filename, mode, options), std::runtime_error);
+  }
+
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+  }
+  {
+    // a later version of the format
+    std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(8);
+    file.put(char(2));
+  }
+  EXPECT_THROW(serial::IBinaryFile(filename, serial::IBinaryFile::Buffered, options), std::runtime_error);
+
+  {
+    serial::OBinaryFile file(filename);
+  }
+  EXPECT_THROW(serial::IBinaryFile(filename, serial::IBinaryFile::Mapped, options), std::runtime_error);
+}
+TEST(SerialHeader, otherByteOrder) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.header = true;
+  const std::vector<double> values = { 1.5, -2.25, 1e300 };
+  const std::vector<Vec3> points = { { 1, 2, 3 }, { 4, 5, 6 } };
+  {
+    serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+    file << 0.5f << 3.75 << values << points << uint32_t(7);
+  }
+  {
+    // what a host of the other byte order writes: the marker of the
+    // header and the floating point values differ, the integers do not
+    std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    bytes[9] = char(bytes[9] == 0 ? 1 : 0);
+    const auto reverse = [&bytes](std::size_t offset, std::size_t width, std::size_t count) {
+      for (std::size_t i = 0; i < count; i++) {
+        std::reverse(bytes.begin() + offset + i * width, bytes.begin() + offset + (i + 1) * width);
+      }
+    };
+    reverse(16, 4, 1);
+    reverse(20, 8, 1);
+    reverse(36, 8, values.size());
+    reverse(68, 4, 3 * points.size());
+    file.seekp(0);
+    file.write(bytes.data(), bytes.size());
+  }
+
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    serial::IBinaryFile file(filename, mode, options);
+    EXPECT_TRUE(file.swapsFloats());
+    float f;
+    double d;
+    std::vector<double> values2;
+    std::vector<Vec3> points2;
+    uint32_t end;
+    file >> f >> d >> values2 >> points2 >> end;
+    EXPECT_EQ(f, 0.5f);
+    EXPECT_EQ(d, 3.75);
+    EXPECT_EQ(values2, values);
+    ASSERT_EQ(points2.size(), points.size());
+    EXPECT_EQ(points2[1].x, 4.0f);
+    EXPECT_EQ(points2[1].z, 6.0f);
+    EXPECT_EQ(end, 7u);
+  }
+}
+TEST(SerialReflection, fieldsInOrder) {
+  const std::string filename = "test.txt";
+  const Person person = { "Ada", 36, { { 1, 2, 3 }, { 4, 5, 6 } } };
+  {
+    serial::OBinaryFile file(filename);
+    file << person << Swapped{ 1.0f, 2.0f };
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::string name;
+    int32_t age;
+    std::vector<float> path;
+    file >> name >> age;
+    EXPECT_EQ(name, "Ada");
+    EXPECT_EQ(age, 36);
+    uint64_t size;
+    file >> size;
+    EXPECT_EQ(size, 2u);
+    for (int i = 0; i < 6; i++) {
+      float x;
+      file >> x;
+      EXPECT_EQ(x, i + 1.0f);
+    }
+    float b, a;
+    file >> b >> a;
+    EXPECT_EQ(b, 2.0f);
+    EXPECT_EQ(a, 1.0f);
+  }
+  {
+    serial::IBinaryFile file(filename);
+    Person person2;
+    Swapped swapped;
+    file >> person2 >> swapped;
+    EXPECT_EQ(person2.name, person.name);
+    EXPECT_EQ(person2.age, person.age);
+    ASSERT_EQ(person2.path.size(), 2u);
+    EXPECT_EQ(person2.path[1].z, 6.0f);
+    EXPECT_EQ(swapped.a, 1.0f);
+    EXPECT_EQ(swapped.b, 2.0f);
+  }
+}
+TEST(SerialReflection, rawVectorIsOneCopy) {
+  const std::string filename = "test.txt";
+  std::vector<Vec3> points(1000);
+  for (std::size_t i = 0; i < points.size(); i++) {
+    points[i] = { float(i), float(i) * 2, float(i) * 3 };
+  }
+  std::vector<Swapped> swapped = { { 1, 2 }, { 3, 4 } };
+  {
+    serial::OBinaryFile file(filename);
+    file << points << swapped;
+  }
+  {
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    std::vector<std::byte> bytes(8 + points.size() * sizeof(Vec3));
+    ASSERT_EQ(std::fread(bytes.data(), 1, bytes.size(), file), bytes.size());
+    EXPECT_EQ(std::memcmp(bytes.data() + 8, points.data(), points.size() * sizeof(Vec3)), 0);
+    std::fclose(file);
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::vector<Vec3> points2;
+    std::vector<Swapped> swapped2;
+    file >> points2 >> swapped2;
+    ASSERT_EQ(points2.size(), points.size());
+    EXPECT_EQ(std::memcmp(points2.data(), points.data(), points.size() * sizeof(Vec3)), 0);
+    ASSERT_EQ(swapped2.size(), 2u);
+    EXPECT_EQ(swapped2[1].a, 3.0f);
+    EXPECT_EQ(swapped2[1].b, 4.0f);
+  }
+}
+namespace {
+  struct Row {
+    uint32_t id;
+    std::string name;
+    double score;
+    int16_t flags;
+    SERIAL_FIELDS(id, name, score, flags)
+  };
+
+  std::vector<Row> makeRows(std::size_t count) {
+    std::vector<Row> rows(count);
+    for (std::size_t i = 0; i < count; i++) {
+      rows[i] = { uint32_t(i), "row" + std::to_string(i), i * 0.5, int16_t(-int(i % 100)) };
+    }
+    return rows;
+  }
+}
+
+TEST(SerialColumnar, columnsAreContiguous) {
+  const std::string filename = "test.txt";
+  const auto rows = makeRows(3);
+  {
+    serial::OBinaryFile file(filename);
+    file << serial::columnar(rows);
+  }
+  {
+    serial::IBinaryFile file(filename);
+    uint64_t size, columns, length;
+    uint32_t id;
+    file >> size >> columns >> length;
+    EXPECT_EQ(size, 3u);
+    EXPECT_EQ(columns, 4u);
+    EXPECT_EQ(length, 3u * 4u);
+    for (uint32_t i = 0; i < 3; i++) {
+      file >> id;
+      EXPECT_EQ(id, i);
+    }
+    std::string name;
+    file >> length >> name;
+    EXPECT_EQ(length, 3u * (8u + 4u));
+    EXPECT_EQ(name, "row0");
+  }
+}
+TEST(SerialColumnar, allColumns) {
+  const std::string filename = "test.txt";
+  const auto rows = makeRows(10000);
+  for (auto encoding : { serial::Encoding::Fixed, serial::Encoding::Compact, serial::Encoding::Native }) {
+    serial::Options options;
+    options.encoding = encoding;
+    {
+      serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+      file << serial::columnar(rows) << uint8_t(42);
+    }
+    {
+      serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+      std::vector<Row> rows2;
+      uint8_t last;
+      file >> serial::columnar(rows2) >> last;
+      ASSERT_EQ(rows2.size(), rows.size());
+      for (std::size_t i = 0; i < rows.size(); i++) {
+        EXPECT_EQ(rows2[i].id, rows[i].id);
+        EXPECT_EQ(rows2[i].name, rows[i].name);
+        EXPECT_EQ(rows2[i].score, rows[i].score);
+        EXPECT_EQ(rows2[i].flags, rows[i].flags);
+      }
+      EXPECT_EQ(last, 42);
+    }
+  }
+}
+TEST(SerialColumnar, someColumns) {
+  const std::string filename = "test.txt";
+  const auto rows = makeRows(10000);
+  serial::Options options;
+  options.bufferSize = 256;
+  {
+    serial::OBinaryFile file(filename);
+    file << serial::columnar(rows) << uint8_t(42);
+  }
+
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    serial::IBinaryFile file(filename, mode, options);
+    std::vector<Row> rows2;
+    uint8_t last;
+    file >> serial::columnar(rows2, { 2 }) >> last;
+    ASSERT_EQ(rows2.size(), rows.size());
+    for (std::size_t i = 0; i < rows.size(); i++) {
+      EXPECT_EQ(rows2[i].id, 0u);
+      EXPECT_TRUE(rows2[i].name.empty());
+      EXPECT_EQ(rows2[i].score, rows[i].score);
+    }
+    EXPECT_EQ(last, 42);
+  }
+}
+TEST(SerialColumnar, skippedColumnsAreNotDecoded) {
+  const std::string filename = "test.txt";
+  const auto rows = makeRows(1000);
+  for (auto encoding : { serial::Encoding::Fixed, serial::Encoding::Compact }) {
+    serial::Options options;
+    options.encoding = encoding;
+    {
+      serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+      file << serial::columnar(rows) << uint8_t(42);
+    }
+
+    // the name column is passed to read the scores
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+    std::vector<Row> rows2;
+    uint8_t last;
+    file >> serial::columnar(rows2, { 2 }) >> last;
+    EXPECT_EQ(rows2[999].score, rows[999].score);
+    EXPECT_EQ(last, 42);
+
+    const serial::Stats stats = file.stats();
+    EXPECT_EQ(stats.primitive(serial::Primitive::String), 0u);
+    EXPECT_EQ(stats.primitive(serial::Primitive::UInt32), 0u);
+    EXPECT_EQ(stats.primitive(serial::Primitive::Int16), 0u);
+    EXPECT_EQ(stats.primitive(serial::Primitive::Double), rows.size());
+  }
+}
+TEST(SerialColumnar, columnOutOfRange) {
+  std::vector<Row> rows;
+  EXPECT_THROW(serial::columnar(rows, { 1, 4 }), std::out_of_range);
+  EXPECT_THROW(serial::columnar(rows, { 64 }), std::out_of_range);
+  EXPECT_NO_THROW(serial::columnar(rows, { 0, 3 }));
+}
+TEST(SerialIBinaryFileBuffer, skip) {
+  const std::string filename = "test.txt";
+  serial::Options options;
+  options.bufferSize = 16;
+  for (auto compression : { serial::Compression::None, serial::Compression::Lz }) {
+    options.compression = compression;
+    {
+      serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+      for (uint32_t i = 0; i < 100; i++) {
+        file << i;
+      }
+    }
+    serial::IBinaryFile file(filename, serial::IBinaryFile::Buffered, options);
+    uint32_t x;
+    file.skip(4 * 50);
+    file >> x;
+    EXPECT_EQ(x, 50u);
+    file.skip(4 * 48);
+    file >> x;
+    EXPECT_EQ(x, 99u);
+    EXPECT_THROW(file.skip(1), std::runtime_error);
+  }
+}
+TEST(SerialParallel, vector) {
+  const std::string filename = "test.txt";
+  std::vector<int32_t> values(100000);
+  for (std::size_t i = 0; i < values.size(); i++) {
+    values[i] = int32_t(i * 2654435761u);
+  }
+  serial::Parallelism parallelism;
+  parallelism.threads = 4;
+  parallelism.chunkSize = 1000;
+
+  for (auto encoding : { serial::Encoding::Fixed, serial::Encoding::Compact }) {
+    serial::Options options;
+    options.encoding = encoding;
+    {
+      serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+      file << serial::parallel(values, parallelism) << uint8_t(42);
+    }
+    for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+      serial::IBinaryFile file(filename, mode, options);
+      std::vector<int32_t> values2;
+      uint8_t last;
+      // the chunk size is read from the file
+      file >> serial::parallel(values2) >> last;
+      EXPECT_EQ(values, values2);
+      EXPECT_EQ(last, 42);
+    }
+  }
+}
+TEST(SerialParallel, stringAndMap) {
+  const std::string filename = "test.txt";
+  std::string text(100000, ' ');
+  for (std::size_t i = 0; i < text.size(); i++) {
+    text[i] = char('a' + i % 26);
+  }
+  std::map<uint64_t, double> map;
+  for (uint64_t i = 0; i < 10000; i++) {
+    map.emplace(i * i, i * 0.25);
+  }
+  serial::Parallelism parallelism;
+  parallelism.threads = 3;
+  parallelism.chunkSize = 777;
+  const std::string empty;
+  {
+    serial::OBinaryFile file(filename);
+    file << serial::parallel(text, parallelism) << serial::parallel(map, parallelism) << serial::parallel(empty);
+  }
+  {
+    serial::IBinaryFile file(filename);
+    std::string text2, empty2 = "x";
+    std::map<uint64_t, double> map2;
+    file >> serial::parallel(text2, parallelism) >> serial::parallel(map2, parallelism) >> serial::parallel(empty2);
+    EXPECT_EQ(text, text2);
+    EXPECT_EQ(map, map2);
+    EXPECT_TRUE(empty2.empty());
+  }
+}
+TEST(SerialParallel, errorsAreRethrown) {
+  std::atomic<int> calls(0);
+  EXPECT_THROW(serial::detail::parallelFor(100, 4, [&](std::size_t i) {
+    calls++;
+    if (i == 10) {
+      throw std::runtime_error("failed");
+    }
+  }), std::runtime_error);
+  EXPECT_LE(calls.load(), 100);
+}
+TEST(SerialBuffer, sameBytesAsFile) {
+  const std::string filename = "test.txt";
+  const std::map<std::string, std::vector<int16_t>> map = { { "a", { 1, -2 } }, { "b", {} } };
+  const Person person = { "Ada", 36, { { 1, 2, 3 } } };
+
+  for (auto encoding : { serial::Encoding::Fixed, serial::Encoding::Compact }) {
+    serial::Options options;
+    options.encoding = encoding;
+    serial::OBinaryBuffer buffer(options);
+    {
+      serial::OBinaryFile file(filename, serial::OBinaryFile::Truncate, options);
+      file << uint64_t(1) << int32_t(-2) << 3.5 << true << std::string("text") << map << person;
+      buffer << uint64_t(1) << int32_t(-2) << 3.5 << true << std::string("text") << map << person;
+    }
+
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    std::vector<std::byte> bytes(buffer.size() + 1);
+    EXPECT_EQ(std::fread(bytes.data(), 1, bytes.size(), file), buffer.size());
+    std::fclose(file);
+    EXPECT_EQ(std::memcmp(bytes.data(), buffer.data(), buffer.size()), 0);
+
+    serial::IBinaryBuffer in(buffer.data(), buffer.size(), options);
+    uint64_t a;
+    int32_t b;
+    double c;
+    bool d;
+    std::string_view e;
+    std::map<std::string, std::vector<int16_t>> map2;
+    Person person2;
+    in >> a >> b >> c >> d >> e >> map2 >> person2;
+    EXPECT_EQ(a, 1u);
+    EXPECT_EQ(b, -2);
+    EXPECT_EQ(c, 3.5);
+    EXPECT_TRUE(d);
+    EXPECT_EQ(e, "text");
+    EXPECT_EQ(map, map2);
+    EXPECT_EQ(person2.name, "Ada");
+    EXPECT_EQ(in.remaining(), 0u);
+    EXPECT_THROW(in >> a, std::runtime_error);
+  }
+}
+TEST(SerialBuffer, releaseAndRange) {
+  serial::OBinaryBuffer buffer;
+  std::vector<uint32_t> values(10000);
+  for (std::size_t i = 0; i < values.size(); i++) {
+    values[i] = uint32_t(i);
+  }
+  buffer << values;
+  const std::vector<std::byte> bytes = buffer.release();
+  EXPECT_EQ(bytes.size(), 8 + 4 * values.size());
+  EXPECT_EQ(buffer.size(), 0u);
+
+  serial::IBinaryBuffer in(bytes.data(), bytes.size());
+  serial::VectorRange<uint32_t, serial::IBinaryBuffer> range(in, 100);
+  uint32_t expected = 0;
+  for (uint32_t value : range) {
+    EXPECT_EQ(value, expected++);
+  }
+  EXPECT_EQ(expected, values.size());
+}
+TEST(SerialParallel, anyElements) {
+  const std::string filename = "test.txt";
+  std::vector<std::string> names(5000);
+  std::map<std::string, std::set<int32_t>> map;
+  for (std::size_t i = 0; i < names.size(); i++) {
+    names[i] = std::to_string(i * i);
+    map[names[i]] = { int32_t(i), -int32_t(i) };
+  }
+  serial::Parallelism parallelism;
+  parallelism.threads = 4;
+  parallelism.chunkSize = 300;
+  {
+    serial::OBinaryFile file(filename);
+    file << serial::parallel(names, parallelism) << serial::parallel(map, parallelism);
+  }
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    serial::IBinaryFile file(filename, mode);
+    std::vector<std::string> names2;
+    std::map<std::string, std::set<int32_t>> map2;
+    file >> serial::parallel(names2, parallelism) >> serial::parallel(map2, parallelism);
+    EXPECT_EQ(names, names2);
+    EXPECT_EQ(map, map2);
+  }
+}
+TEST(SerialPmr, containers) {
+  const std::string filename = "test.txt";
+  const std::map<std::string, std::vector<int32_t>> map = { { "a", { 1, 2 } }, { "bb", { 3 } } };
+  const std::vector<std::string> names = { "x", std::string(100, 'y') };
+  {
+    serial::OBinaryFile file(filename);
+    file << map << names << std::set<std::string>{ "s", "t" };
+  }
+  {
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::map<std::pmr::string, std::pmr::vector<int32_t>> map2(&arena);
+    std::pmr::vector<std::pmr::string> names2(&arena);
+    std::pmr::set<std::pmr::string> set2(&arena);
+
+    // nothing may come from the default resource
+    auto* previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+    {
+      serial::IBinaryFile file(filename);
+      EXPECT_NO_THROW(file >> map2 >> names2 >> set2);
+    }
+    std::pmr::set_default_resource(previous);
+
+    ASSERT_EQ(map2.size(), 2u);
+    EXPECT_EQ(map2.at("bb").at(0), 3);
+    EXPECT_EQ(map2.at("a").get_allocator().resource(), &arena);
+    ASSERT_EQ(names2.size(), 2u);
+    EXPECT_EQ(std::string_view(names2[1]), names[1]);
+    EXPECT_EQ(names2[1].get_allocator().resource(), &arena);
+    EXPECT_EQ(set2.size(), 2u);
+  }
+}
+TEST(SerialPmr, loadInArena) {
+  const std::string filename = "test.txt";
+  std::map<uint32_t, std::vector<std::string>> map;
+  for (uint32_t i = 0; i < 100; i++) {
+    map[i] = { std::to_string(i), std::string(50, 'z') };
+  }
+  {
+    serial::OBinaryFile file(filename);
+    file << map;
+  }
+
+  using Map = std::pmr::map<uint32_t, std::pmr::vector<std::pmr::string>>;
+  std::pmr::monotonic_buffer_resource arena;
+  serial::IBinaryFile file(filename);
+  auto* previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+  Map map2 = serial::load<Map>(file, arena);
+  std::pmr::set_default_resource(previous);
+
+  EXPECT_EQ(map2.get_allocator().resource(), &arena);
+  ASSERT_EQ(map2.size(), map.size());
+  EXPECT_EQ(map2[42][0], "42");
+  EXPECT_EQ(std::string_view(map2[42][1]), map[42][1]);
+}
+TEST(SerialStats, writeCounters) {
+  serial::OBinaryFile file("test.txt");
+  file << uint32_t(1) << std::string("abc") << std::vector<uint16_t>{ 1, 2, 3 };
+  file.flush();
+
+  const serial::Stats stats = file.stats();
+  EXPECT_EQ(stats.bytes, 4u + 8u + 3u + 8u + 6u);
+  EXPECT_EQ(stats.ioBytes, stats.bytes);
+  EXPECT_GE(stats.ioCalls, 1u);
+  EXPECT_EQ(stats.flushes, 1u);
+  EXPECT_EQ(stats.primitive(serial::Primitive::UInt32), 1u);
+  EXPECT_EQ(stats.primitive(serial::Primitive::String), 1u);
+  EXPECT_EQ(stats.primitive(serial::Primitive::UInt16), 3u);
+  EXPECT_EQ(stats.primitive(serial::Primitive::UInt64), 2u);
+  EXPECT_EQ(stats.containers, 1u);
+  EXPECT_EQ(stats.elements, 3u);
+}
+TEST(SerialStats, readCounters) {
+  const std::string filename = "test.txt";
+  const std::map<uint8_t, double> map = { { 1, 0.5 }, { 2, 1.5 } };
+  {
+    serial::OBinaryFile file(filename);
+    file << map;
+  }
+
+  for (auto mode : { serial::IBinaryFile::Buffered, serial::IBinaryFile::Mapped }) {
+    serial::IBinaryFile file(filename, mode);
+    std::map<uint8_t, double> map2;
+    file >> map2;
+    EXPECT_EQ(map, map2);
+
+    const serial::Stats stats = file.stats();
+    EXPECT_EQ(stats.bytes, 8u + 2u * 9u);
+    EXPECT_EQ(stats.primitive(serial::Primitive::UInt8), 2u);
+    EXPECT_EQ(stats.primitive(serial::Primitive::Double), 2u);
+    EXPECT_EQ(stats.containers, 1u);
+    EXPECT_EQ(stats.elements, 2u);
+    if (mode == serial::IBinaryFile::Mapped) {
+      EXPECT_EQ(stats.ioCalls, 0u);
+    } else {
+      EXPECT_EQ(stats.ioBytes, stats.bytes);
+    }
+  }
+}
+TEST(SerialStats, asyncAndCompressed) {
+  serial::Options options;
+  options.async = true;
+  options.compression = serial::Compression::Lz;
+  serial::OBinaryFile file("test.txt", serial::OBinaryFile::Truncate, options);
+  file << std::vector<uint64_t>(100000, 7);
+  file.flush();
+
+  // the thread made the calls, and the blocks are smaller than the values
+  const serial::Stats stats = file.stats();
+  EXPECT_EQ(stats.bytes, 8u + 800000u);
+  EXPECT_GE(stats.ioCalls, 1u);
+  EXPECT_GT(stats.ioBytes, 0u);
+  EXPECT_LT(stats.ioBytes, stats.bytes);
+}
+
 int main(int argc, char* argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();